@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cart.h"
+#include "rom.h"
+#include "utils.h"
+
+static const uint32_t _ram_sizes[] = {0, 0x800, 0x2000, 0x8000, 0x20000, 0x10000};
+
+static void _map(gb_cart_t *cart) {
+	uint16_t low = cart->bank_low;
+	uint16_t rom0 = 0;
+	uint16_t romx = 0;
+	uint8_t ram = 0;
+
+	switch (cart->mbc) {
+		case MBC_NONE:
+			romx = 1;
+			break;
+		case MBC_1:
+			// bank 0 can't be selected in the switchable window, 0x20/0x40/0x60 become 0x21/0x41/0x61
+			romx = (cart->bank_high << 5) | (low & 0x1f ? low & 0x1f : 1);
+			if (cart->mode) {
+				rom0 = cart->bank_high << 5;
+				ram = cart->bank_high;
+			}
+			break;
+		case MBC_2:
+			romx = low & 0x0f ? low & 0x0f : 1;
+			break;
+		case MBC_3:
+			romx = low & 0x7f ? low & 0x7f : 1;
+			ram = cart->bank_high & 0x03;
+			break;
+		case MBC_5:
+			romx = low & 0x1ff;
+			ram = cart->bank_high & 0x0f;
+			break;
+	}
+
+	cart->rom_bank[0] = rom0 % cart->rom_banks;
+	cart->rom_bank[1] = romx % cart->rom_banks;
+	cart->rom_map[0] = cart->rom + cart->rom_bank[0] * ROM_BANK_SIZE;
+	cart->rom_map[1] = cart->rom + cart->rom_bank[1] * ROM_BANK_SIZE;
+
+	// mbc2 nibbles, rtc registers and disabled ram all go through cart_read_ram
+	cart->ram_bank = cart->ram_banks ? ram % cart->ram_banks : 0;
+	cart->ram_map = NULL;
+	if (cart->ram_enabled && cart->ram_banks && cart->mbc != MBC_2 && !cart->rtc_select)
+		cart->ram_map = cart->ram + cart->ram_bank * RAM_BANK_SIZE;
+}
+
+bool init_cart(gb_cart_t *cart, const uint8_t *rom, uint32_t size) {
+	memset(cart, 0, sizeof(gb_cart_t));
+	cart->rom = rom;
+	cart->rom_size = size;
+	cart->rom_banks = size / ROM_BANK_SIZE;
+	if (cart->rom_banks < 2) {
+		err("Rom image is smaller than two banks.\n");
+		return 0;
+	}
+
+	const struct rom_header *header = (const struct rom_header *)(rom + 0x100);
+	cart->type = header->cartridge_type;
+	switch (cart->type) {
+		case 0x00: cart->mbc = MBC_NONE; break;
+		case 0x08: cart->mbc = MBC_NONE; break;
+		case 0x09: cart->mbc = MBC_NONE; cart->has_battery = 1; break;
+		case 0x01: case 0x02: cart->mbc = MBC_1; break;
+		case 0x03: cart->mbc = MBC_1; cart->has_battery = 1; break;
+		case 0x05: cart->mbc = MBC_2; break;
+		case 0x06: cart->mbc = MBC_2; cart->has_battery = 1; break;
+		case 0x0f: case 0x10: cart->mbc = MBC_3; cart->has_battery = 1; cart->has_rtc = 1; break;
+		case 0x11: case 0x12: cart->mbc = MBC_3; break;
+		case 0x13: cart->mbc = MBC_3; cart->has_battery = 1; break;
+		case 0x19: case 0x1a: case 0x1c: case 0x1d: cart->mbc = MBC_5; break;
+		case 0x1b: case 0x1e: cart->mbc = MBC_5; cart->has_battery = 1; break;
+		default:
+			fprintf(stderr, "Unsupported cartridge type 0x%02x.\n", cart->type);
+			return 0;
+	}
+
+	if (cart->mbc == MBC_2)
+		cart->ram_size = MBC2_RAM_SIZE;
+	else if (header->ram_size < sizeof(_ram_sizes) / sizeof(_ram_sizes[0]))
+		cart->ram_size = _ram_sizes[header->ram_size];
+
+	if (cart->ram_size) {
+		// chips smaller than a bank still get a whole one so the window can point straight at it
+		uint32_t allocated = cart->ram_size < RAM_BANK_SIZE ? RAM_BANK_SIZE : cart->ram_size;
+		cart->ram = calloc(1, allocated);
+		cart->ram_banks = allocated / RAM_BANK_SIZE;
+	}
+
+	// rom only boards have their ram permanently enabled
+	cart->ram_enabled = cart->mbc == MBC_NONE;
+	_map(cart);
+	return 1;
+}
+
+/* for when the registers were set from outside, like a save state */
+void cart_remap(gb_cart_t *cart) {
+	_map(cart);
+}
+
+void free_cart(gb_cart_t *cart) {
+	free(cart->ram);
+	cart->ram = NULL;
+	cart->ram_map = NULL;
+}
+
+uint8_t cart_read_ram(gb_cart_t *cart, uint16_t address) {
+	if (!cart->ram_enabled)
+		return 0xff;
+	if (cart->rtc_select)
+		return cart->rtc_latched[cart->rtc_select - 0x08];
+	if (cart->mbc == MBC_2)
+		return cart->ram[address & (MBC2_RAM_SIZE - 1)] | 0xf0;
+	if (!cart->ram_map)
+		return 0xff;
+	return cart->ram_map[address & (RAM_BANK_SIZE - 1)];
+}
+
+static void _write_rtc(gb_cart_t *cart, uint8_t value) {
+	static const uint8_t masks[RTC_COUNT] = {0x3f, 0x3f, 0x1f, 0xff, 0xc1};
+	uint8_t reg = cart->rtc_select - 0x08;
+	cart->rtc[reg] = value & masks[reg];
+	cart->rtc_latched[reg] = cart->rtc[reg];
+}
+
+static void _write_ram(gb_cart_t *cart, uint16_t address, uint8_t value) {
+	if (!cart->ram_enabled)
+		return;
+	if (cart->rtc_select)
+		_write_rtc(cart, value);
+	else if (cart->mbc == MBC_2)
+		cart->ram[address & (MBC2_RAM_SIZE - 1)] = value & 0x0f;
+	else if (cart->ram_map)
+		cart->ram_map[address & (RAM_BANK_SIZE - 1)] = value;
+}
+
+void cart_write(gb_cart_t *cart, uint16_t address, uint8_t value) {
+	if (address >= 0xa000) {
+		_write_ram(cart, address, value);
+		return;
+	}
+
+	switch (cart->mbc) {
+		case MBC_NONE:
+			return;
+		case MBC_1:
+			if (address < 0x2000)
+				cart->ram_enabled = (value & 0x0f) == 0x0a;
+			else if (address < 0x4000)
+				cart->bank_low = value & 0x1f;
+			else if (address < 0x6000)
+				cart->bank_high = value & 0x03;
+			else
+				cart->mode = value & 0x01;
+			break;
+		case MBC_2:
+			// address bit 8 selects between ram enable and the rom bank
+			if (address >= 0x4000)
+				return;
+			if (address & 0x100)
+				cart->bank_low = value & 0x0f;
+			else
+				cart->ram_enabled = (value & 0x0f) == 0x0a;
+			break;
+		case MBC_3:
+			if (address < 0x2000) {
+				cart->ram_enabled = (value & 0x0f) == 0x0a;
+			} else if (address < 0x4000) {
+				cart->bank_low = value & 0x7f;
+			} else if (address < 0x6000) {
+				cart->rtc_select = 0;
+				if (value <= 0x03)
+					cart->bank_high = value;
+				else if (cart->has_rtc && value >= 0x08 && value <= 0x0c)
+					cart->rtc_select = value;
+			} else {
+				// writing 0 then 1 copies the running clock into the readable registers
+				if (cart->rtc_latch == 0 && value == 1)
+					memcpy(cart->rtc_latched, cart->rtc, RTC_COUNT);
+				cart->rtc_latch = value;
+			}
+			break;
+		case MBC_5:
+			if (address < 0x2000)
+				cart->ram_enabled = (value & 0x0f) == 0x0a;
+			else if (address < 0x3000)
+				cart->bank_low = (cart->bank_low & 0x100) | value;
+			else if (address < 0x4000)
+				cart->bank_low = (cart->bank_low & 0xff) | ((value & 0x01) << 8);
+			else if (address < 0x6000)
+				cart->bank_high = value & 0x0f;
+			break;
+	}
+
+	_map(cart);
+}
+
+/* called once per emulated second so the clock follows emulated time, not the host's */
+void cart_tick_rtc(gb_cart_t *cart) {
+	uint8_t *rtc = cart->rtc;
+	if (rtc[RTC_DH] & 0x40)
+		return;
+
+	if (++rtc[RTC_S] < 60)
+		return;
+	rtc[RTC_S] = 0;
+	if (++rtc[RTC_M] < 60)
+		return;
+	rtc[RTC_M] = 0;
+	if (++rtc[RTC_H] < 24)
+		return;
+	rtc[RTC_H] = 0;
+	if (++rtc[RTC_DL])
+		return;
+	if (rtc[RTC_DH] & 0x01)
+		rtc[RTC_DH] = (rtc[RTC_DH] & ~0x01) | 0x80;
+	else
+		rtc[RTC_DH] |= 0x01;
+}
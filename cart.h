@@ -0,0 +1,68 @@
+#ifndef cart_h
+#define cart_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ROM_BANK_SIZE 0x4000
+#define RAM_BANK_SIZE 0x2000
+#define MBC2_RAM_SIZE 0x200
+#define CYCLES_PER_SECOND 4194304
+
+typedef enum {
+	MBC_NONE,
+	MBC_1,
+	MBC_2,
+	MBC_3,
+	MBC_5
+} gb_mbc_t;
+
+/* seconds, minutes, hours, day low, day high (bit 0 day bit 8, bit 6 halt, bit 7 day carry) */
+typedef enum {
+	RTC_S,
+	RTC_M,
+	RTC_H,
+	RTC_DL,
+	RTC_DH,
+	RTC_COUNT
+} gb_rtc_register_t;
+
+typedef struct {
+	gb_mbc_t mbc;
+	uint8_t type;
+	bool has_battery;
+	bool has_rtc;
+
+	const uint8_t *rom;
+	uint32_t rom_size;
+	uint16_t rom_banks;
+	uint8_t *ram;
+	uint32_t ram_size;
+	uint8_t ram_banks;
+
+	/* raw register state as last written by the game */
+	bool ram_enabled;
+	uint16_t bank_low;
+	uint8_t bank_high;
+	uint8_t mode;
+	uint8_t rtc_select;
+	uint8_t rtc_latch;
+
+	uint8_t rtc[RTC_COUNT];
+	uint8_t rtc_latched[RTC_COUNT];
+
+	/* resolved mapping, a bank switch only rewrites these */
+	uint16_t rom_bank[2];
+	uint8_t ram_bank;
+	const uint8_t *rom_map[2];
+	uint8_t *ram_map;
+} gb_cart_t;
+
+bool init_cart(gb_cart_t *cart, const uint8_t *rom, uint32_t size);
+void free_cart(gb_cart_t *cart);
+void cart_remap(gb_cart_t *cart);
+uint8_t cart_read_ram(gb_cart_t *cart, uint16_t address);
+void cart_write(gb_cart_t *cart, uint16_t address, uint8_t value);
+void cart_tick_rtc(gb_cart_t *cart);
+
+#endif
@@ -1,1616 +1,1149 @@
+#include <string.h>
 #include "cpu.h"
-static inline void set_flag(gb_cpu_t *cpu, uint8_t bit, bool status);
-
-void init_cpu(gb_cpu_t *cpu, gb_ppu_t *ppu) {
+#include "jit.h"
+
+/* 0 is either a nonexistant opcode or it indicates
+an opcode with a variable length cycle count,
+which is handled in the instruction implementation instead */
+
+static const uint8_t _instruction_cycle_count[256] = {
+	//0  1   2   3   4   5   6   7   8   9   A   B   C   D   E   F
+	4,  12, 8,  8,  4,  4,  8,  4,  20, 8,  8,  8,  4,  4,  8,  4,  // 0
+	4,  12, 8,  8,  4,  4,  8,  4,  12, 8,  8,  8,  4,  4,  8,  4,  // 1
+	0,  12, 8,  8,  4,  4,  8,  4,  0,  8,  8,  8,  4,  4,  8,  4,  // 2
+	0,  12, 8,  8,  12, 12, 12, 4,  0,  8,  8,  8,  4,  4,  8,  4,  // 3
+	4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 4
+	4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 5
+	4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 6
+	8,  8,  8,  8,  8,  8,  4,  8,  4,  4,  4,  4,  4,  4,  8,  4,  // 7
+	4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 8
+	4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // 9
+	4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // A
+	4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,  // B
+	0,  12, 0,  16, 0,  16, 8,  16, 0,  16, 0,  4,  0,  24, 8,  16, // C
+	0,  12, 0,  0,  0,  16, 8,  16, 0,  16, 0,  0,  0,  0,  8,  16, // D
+	12, 12, 8,  0,  0,  16, 8,  16, 16, 4,  16, 0,  0,  0,  8,  16, // E
+	12, 12, 8,  4,  0,  16, 8,  16, 12, 8,  16, 4,  0,  0,  8,  16  // F
+};
+
+static const uint8_t _instruction_byte_size[256] = {
+	//0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+	1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1, // 0
+	2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 1
+	2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 2
+	2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1, // 3
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 4
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 5
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 6
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 7
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 8
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 9
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // A
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // B
+	1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1, // C
+	1, 1, 3, 0, 3, 1, 2, 1, 1, 1, 3, 0, 3, 0, 2, 1, // D
+	2, 1, 1, 0, 0, 1, 2, 1, 2, 1, 3, 0, 0, 0, 2, 1, // E
+	2, 1, 1, 1, 0, 1, 2, 1, 2, 1, 3, 1, 0, 0, 2, 1  // F
+};
+
+/*
+ * daa result in the low byte and the carry out in bit 8, indexed by a | n << 8 | h << 9 | c << 10.
+ * generated from the usual adjust: +0x60 when c or a > 0x99, +0x06 when h or the low digit > 9,
+ * after subtraction only c and h count and the adjustments are subtracted
+ */
+static const uint16_t _daa_table[2048] = {
+	0x000, 0x001, 0x002, 0x003, 0x004, 0x005, 0x006, 0x007, 0x008, 0x009, 0x010, 0x011, 0x012, 0x013, 0x014, 0x015, // 000
+	0x010, 0x011, 0x012, 0x013, 0x014, 0x015, 0x016, 0x017, 0x018, 0x019, 0x020, 0x021, 0x022, 0x023, 0x024, 0x025, // 010
+	0x020, 0x021, 0x022, 0x023, 0x024, 0x025, 0x026, 0x027, 0x028, 0x029, 0x030, 0x031, 0x032, 0x033, 0x034, 0x035, // 020
+	0x030, 0x031, 0x032, 0x033, 0x034, 0x035, 0x036, 0x037, 0x038, 0x039, 0x040, 0x041, 0x042, 0x043, 0x044, 0x045, // 030
+	0x040, 0x041, 0x042, 0x043, 0x044, 0x045, 0x046, 0x047, 0x048, 0x049, 0x050, 0x051, 0x052, 0x053, 0x054, 0x055, // 040
+	0x050, 0x051, 0x052, 0x053, 0x054, 0x055, 0x056, 0x057, 0x058, 0x059, 0x060, 0x061, 0x062, 0x063, 0x064, 0x065, // 050
+	0x060, 0x061, 0x062, 0x063, 0x064, 0x065, 0x066, 0x067, 0x068, 0x069, 0x070, 0x071, 0x072, 0x073, 0x074, 0x075, // 060
+	0x070, 0x071, 0x072, 0x073, 0x074, 0x075, 0x076, 0x077, 0x078, 0x079, 0x080, 0x081, 0x082, 0x083, 0x084, 0x085, // 070
+	0x080, 0x081, 0x082, 0x083, 0x084, 0x085, 0x086, 0x087, 0x088, 0x089, 0x090, 0x091, 0x092, 0x093, 0x094, 0x095, // 080
+	0x090, 0x091, 0x092, 0x093, 0x094, 0x095, 0x096, 0x097, 0x098, 0x099, 0x100, 0x101, 0x102, 0x103, 0x104, 0x105, // 090
+	0x100, 0x101, 0x102, 0x103, 0x104, 0x105, 0x106, 0x107, 0x108, 0x109, 0x110, 0x111, 0x112, 0x113, 0x114, 0x115, // 0a0
+	0x110, 0x111, 0x112, 0x113, 0x114, 0x115, 0x116, 0x117, 0x118, 0x119, 0x120, 0x121, 0x122, 0x123, 0x124, 0x125, // 0b0
+	0x120, 0x121, 0x122, 0x123, 0x124, 0x125, 0x126, 0x127, 0x128, 0x129, 0x130, 0x131, 0x132, 0x133, 0x134, 0x135, // 0c0
+	0x130, 0x131, 0x132, 0x133, 0x134, 0x135, 0x136, 0x137, 0x138, 0x139, 0x140, 0x141, 0x142, 0x143, 0x144, 0x145, // 0d0
+	0x140, 0x141, 0x142, 0x143, 0x144, 0x145, 0x146, 0x147, 0x148, 0x149, 0x150, 0x151, 0x152, 0x153, 0x154, 0x155, // 0e0
+	0x150, 0x151, 0x152, 0x153, 0x154, 0x155, 0x156, 0x157, 0x158, 0x159, 0x160, 0x161, 0x162, 0x163, 0x164, 0x165, // 0f0
+	0x000, 0x001, 0x002, 0x003, 0x004, 0x005, 0x006, 0x007, 0x008, 0x009, 0x00a, 0x00b, 0x00c, 0x00d, 0x00e, 0x00f, // 100
+	0x010, 0x011, 0x012, 0x013, 0x014, 0x015, 0x016, 0x017, 0x018, 0x019, 0x01a, 0x01b, 0x01c, 0x01d, 0x01e, 0x01f, // 110
+	0x020, 0x021, 0x022, 0x023, 0x024, 0x025, 0x026, 0x027, 0x028, 0x029, 0x02a, 0x02b, 0x02c, 0x02d, 0x02e, 0x02f, // 120
+	0x030, 0x031, 0x032, 0x033, 0x034, 0x035, 0x036, 0x037, 0x038, 0x039, 0x03a, 0x03b, 0x03c, 0x03d, 0x03e, 0x03f, // 130
+	0x040, 0x041, 0x042, 0x043, 0x044, 0x045, 0x046, 0x047, 0x048, 0x049, 0x04a, 0x04b, 0x04c, 0x04d, 0x04e, 0x04f, // 140
+	0x050, 0x051, 0x052, 0x053, 0x054, 0x055, 0x056, 0x057, 0x058, 0x059, 0x05a, 0x05b, 0x05c, 0x05d, 0x05e, 0x05f, // 150
+	0x060, 0x061, 0x062, 0x063, 0x064, 0x065, 0x066, 0x067, 0x068, 0x069, 0x06a, 0x06b, 0x06c, 0x06d, 0x06e, 0x06f, // 160
+	0x070, 0x071, 0x072, 0x073, 0x074, 0x075, 0x076, 0x077, 0x078, 0x079, 0x07a, 0x07b, 0x07c, 0x07d, 0x07e, 0x07f, // 170
+	0x080, 0x081, 0x082, 0x083, 0x084, 0x085, 0x086, 0x087, 0x088, 0x089, 0x08a, 0x08b, 0x08c, 0x08d, 0x08e, 0x08f, // 180
+	0x090, 0x091, 0x092, 0x093, 0x094, 0x095, 0x096, 0x097, 0x098, 0x099, 0x09a, 0x09b, 0x09c, 0x09d, 0x09e, 0x09f, // 190
+	0x0a0, 0x0a1, 0x0a2, 0x0a3, 0x0a4, 0x0a5, 0x0a6, 0x0a7, 0x0a8, 0x0a9, 0x0aa, 0x0ab, 0x0ac, 0x0ad, 0x0ae, 0x0af, // 1a0
+	0x0b0, 0x0b1, 0x0b2, 0x0b3, 0x0b4, 0x0b5, 0x0b6, 0x0b7, 0x0b8, 0x0b9, 0x0ba, 0x0bb, 0x0bc, 0x0bd, 0x0be, 0x0bf, // 1b0
+	0x0c0, 0x0c1, 0x0c2, 0x0c3, 0x0c4, 0x0c5, 0x0c6, 0x0c7, 0x0c8, 0x0c9, 0x0ca, 0x0cb, 0x0cc, 0x0cd, 0x0ce, 0x0cf, // 1c0
+	0x0d0, 0x0d1, 0x0d2, 0x0d3, 0x0d4, 0x0d5, 0x0d6, 0x0d7, 0x0d8, 0x0d9, 0x0da, 0x0db, 0x0dc, 0x0dd, 0x0de, 0x0df, // 1d0
+	0x0e0, 0x0e1, 0x0e2, 0x0e3, 0x0e4, 0x0e5, 0x0e6, 0x0e7, 0x0e8, 0x0e9, 0x0ea, 0x0eb, 0x0ec, 0x0ed, 0x0ee, 0x0ef, // 1e0
+	0x0f0, 0x0f1, 0x0f2, 0x0f3, 0x0f4, 0x0f5, 0x0f6, 0x0f7, 0x0f8, 0x0f9, 0x0fa, 0x0fb, 0x0fc, 0x0fd, 0x0fe, 0x0ff, // 1f0
+	0x006, 0x007, 0x008, 0x009, 0x00a, 0x00b, 0x00c, 0x00d, 0x00e, 0x00f, 0x010, 0x011, 0x012, 0x013, 0x014, 0x015, // 200
+	0x016, 0x017, 0x018, 0x019, 0x01a, 0x01b, 0x01c, 0x01d, 0x01e, 0x01f, 0x020, 0x021, 0x022, 0x023, 0x024, 0x025, // 210
+	0x026, 0x027, 0x028, 0x029, 0x02a, 0x02b, 0x02c, 0x02d, 0x02e, 0x02f, 0x030, 0x031, 0x032, 0x033, 0x034, 0x035, // 220
+	0x036, 0x037, 0x038, 0x039, 0x03a, 0x03b, 0x03c, 0x03d, 0x03e, 0x03f, 0x040, 0x041, 0x042, 0x043, 0x044, 0x045, // 230
+	0x046, 0x047, 0x048, 0x049, 0x04a, 0x04b, 0x04c, 0x04d, 0x04e, 0x04f, 0x050, 0x051, 0x052, 0x053, 0x054, 0x055, // 240
+	0x056, 0x057, 0x058, 0x059, 0x05a, 0x05b, 0x05c, 0x05d, 0x05e, 0x05f, 0x060, 0x061, 0x062, 0x063, 0x064, 0x065, // 250
+	0x066, 0x067, 0x068, 0x069, 0x06a, 0x06b, 0x06c, 0x06d, 0x06e, 0x06f, 0x070, 0x071, 0x072, 0x073, 0x074, 0x075, // 260
+	0x076, 0x077, 0x078, 0x079, 0x07a, 0x07b, 0x07c, 0x07d, 0x07e, 0x07f, 0x080, 0x081, 0x082, 0x083, 0x084, 0x085, // 270
+	0x086, 0x087, 0x088, 0x089, 0x08a, 0x08b, 0x08c, 0x08d, 0x08e, 0x08f, 0x090, 0x091, 0x092, 0x093, 0x094, 0x095, // 280
+	0x096, 0x097, 0x098, 0x099, 0x09a, 0x09b, 0x09c, 0x09d, 0x09e, 0x09f, 0x100, 0x101, 0x102, 0x103, 0x104, 0x105, // 290
+	0x106, 0x107, 0x108, 0x109, 0x10a, 0x10b, 0x10c, 0x10d, 0x10e, 0x10f, 0x110, 0x111, 0x112, 0x113, 0x114, 0x115, // 2a0
+	0x116, 0x117, 0x118, 0x119, 0x11a, 0x11b, 0x11c, 0x11d, 0x11e, 0x11f, 0x120, 0x121, 0x122, 0x123, 0x124, 0x125, // 2b0
+	0x126, 0x127, 0x128, 0x129, 0x12a, 0x12b, 0x12c, 0x12d, 0x12e, 0x12f, 0x130, 0x131, 0x132, 0x133, 0x134, 0x135, // 2c0
+	0x136, 0x137, 0x138, 0x139, 0x13a, 0x13b, 0x13c, 0x13d, 0x13e, 0x13f, 0x140, 0x141, 0x142, 0x143, 0x144, 0x145, // 2d0
+	0x146, 0x147, 0x148, 0x149, 0x14a, 0x14b, 0x14c, 0x14d, 0x14e, 0x14f, 0x150, 0x151, 0x152, 0x153, 0x154, 0x155, // 2e0
+	0x156, 0x157, 0x158, 0x159, 0x15a, 0x15b, 0x15c, 0x15d, 0x15e, 0x15f, 0x160, 0x161, 0x162, 0x163, 0x164, 0x165, // 2f0
+	0x0fa, 0x0fb, 0x0fc, 0x0fd, 0x0fe, 0x0ff, 0x000, 0x001, 0x002, 0x003, 0x004, 0x005, 0x006, 0x007, 0x008, 0x009, // 300
+	0x00a, 0x00b, 0x00c, 0x00d, 0x00e, 0x00f, 0x010, 0x011, 0x012, 0x013, 0x014, 0x015, 0x016, 0x017, 0x018, 0x019, // 310
+	0x01a, 0x01b, 0x01c, 0x01d, 0x01e, 0x01f, 0x020, 0x021, 0x022, 0x023, 0x024, 0x025, 0x026, 0x027, 0x028, 0x029, // 320
+	0x02a, 0x02b, 0x02c, 0x02d, 0x02e, 0x02f, 0x030, 0x031, 0x032, 0x033, 0x034, 0x035, 0x036, 0x037, 0x038, 0x039, // 330
+	0x03a, 0x03b, 0x03c, 0x03d, 0x03e, 0x03f, 0x040, 0x041, 0x042, 0x043, 0x044, 0x045, 0x046, 0x047, 0x048, 0x049, // 340
+	0x04a, 0x04b, 0x04c, 0x04d, 0x04e, 0x04f, 0x050, 0x051, 0x052, 0x053, 0x054, 0x055, 0x056, 0x057, 0x058, 0x059, // 350
+	0x05a, 0x05b, 0x05c, 0x05d, 0x05e, 0x05f, 0x060, 0x061, 0x062, 0x063, 0x064, 0x065, 0x066, 0x067, 0x068, 0x069, // 360
+	0x06a, 0x06b, 0x06c, 0x06d, 0x06e, 0x06f, 0x070, 0x071, 0x072, 0x073, 0x074, 0x075, 0x076, 0x077, 0x078, 0x079, // 370
+	0x07a, 0x07b, 0x07c, 0x07d, 0x07e, 0x07f, 0x080, 0x081, 0x082, 0x083, 0x084, 0x085, 0x086, 0x087, 0x088, 0x089, // 380
+	0x08a, 0x08b, 0x08c, 0x08d, 0x08e, 0x08f, 0x090, 0x091, 0x092, 0x093, 0x094, 0x095, 0x096, 0x097, 0x098, 0x099, // 390
+	0x09a, 0x09b, 0x09c, 0x09d, 0x09e, 0x09f, 0x0a0, 0x0a1, 0x0a2, 0x0a3, 0x0a4, 0x0a5, 0x0a6, 0x0a7, 0x0a8, 0x0a9, // 3a0
+	0x0aa, 0x0ab, 0x0ac, 0x0ad, 0x0ae, 0x0af, 0x0b0, 0x0b1, 0x0b2, 0x0b3, 0x0b4, 0x0b5, 0x0b6, 0x0b7, 0x0b8, 0x0b9, // 3b0
+	0x0ba, 0x0bb, 0x0bc, 0x0bd, 0x0be, 0x0bf, 0x0c0, 0x0c1, 0x0c2, 0x0c3, 0x0c4, 0x0c5, 0x0c6, 0x0c7, 0x0c8, 0x0c9, // 3c0
+	0x0ca, 0x0cb, 0x0cc, 0x0cd, 0x0ce, 0x0cf, 0x0d0, 0x0d1, 0x0d2, 0x0d3, 0x0d4, 0x0d5, 0x0d6, 0x0d7, 0x0d8, 0x0d9, // 3d0
+	0x0da, 0x0db, 0x0dc, 0x0dd, 0x0de, 0x0df, 0x0e0, 0x0e1, 0x0e2, 0x0e3, 0x0e4, 0x0e5, 0x0e6, 0x0e7, 0x0e8, 0x0e9, // 3e0
+	0x0ea, 0x0eb, 0x0ec, 0x0ed, 0x0ee, 0x0ef, 0x0f0, 0x0f1, 0x0f2, 0x0f3, 0x0f4, 0x0f5, 0x0f6, 0x0f7, 0x0f8, 0x0f9, // 3f0
+	0x160, 0x161, 0x162, 0x163, 0x164, 0x165, 0x166, 0x167, 0x168, 0x169, 0x170, 0x171, 0x172, 0x173, 0x174, 0x175, // 400
+	0x170, 0x171, 0x172, 0x173, 0x174, 0x175, 0x176, 0x177, 0x178, 0x179, 0x180, 0x181, 0x182, 0x183, 0x184, 0x185, // 410
+	0x180, 0x181, 0x182, 0x183, 0x184, 0x185, 0x186, 0x187, 0x188, 0x189, 0x190, 0x191, 0x192, 0x193, 0x194, 0x195, // 420
+	0x190, 0x191, 0x192, 0x193, 0x194, 0x195, 0x196, 0x197, 0x198, 0x199, 0x1a0, 0x1a1, 0x1a2, 0x1a3, 0x1a4, 0x1a5, // 430
+	0x1a0, 0x1a1, 0x1a2, 0x1a3, 0x1a4, 0x1a5, 0x1a6, 0x1a7, 0x1a8, 0x1a9, 0x1b0, 0x1b1, 0x1b2, 0x1b3, 0x1b4, 0x1b5, // 440
+	0x1b0, 0x1b1, 0x1b2, 0x1b3, 0x1b4, 0x1b5, 0x1b6, 0x1b7, 0x1b8, 0x1b9, 0x1c0, 0x1c1, 0x1c2, 0x1c3, 0x1c4, 0x1c5, // 450
+	0x1c0, 0x1c1, 0x1c2, 0x1c3, 0x1c4, 0x1c5, 0x1c6, 0x1c7, 0x1c8, 0x1c9, 0x1d0, 0x1d1, 0x1d2, 0x1d3, 0x1d4, 0x1d5, // 460
+	0x1d0, 0x1d1, 0x1d2, 0x1d3, 0x1d4, 0x1d5, 0x1d6, 0x1d7, 0x1d8, 0x1d9, 0x1e0, 0x1e1, 0x1e2, 0x1e3, 0x1e4, 0x1e5, // 470
+	0x1e0, 0x1e1, 0x1e2, 0x1e3, 0x1e4, 0x1e5, 0x1e6, 0x1e7, 0x1e8, 0x1e9, 0x1f0, 0x1f1, 0x1f2, 0x1f3, 0x1f4, 0x1f5, // 480
+	0x1f0, 0x1f1, 0x1f2, 0x1f3, 0x1f4, 0x1f5, 0x1f6, 0x1f7, 0x1f8, 0x1f9, 0x100, 0x101, 0x102, 0x103, 0x104, 0x105, // 490
+	0x100, 0x101, 0x102, 0x103, 0x104, 0x105, 0x106, 0x107, 0x108, 0x109, 0x110, 0x111, 0x112, 0x113, 0x114, 0x115, // 4a0
+	0x110, 0x111, 0x112, 0x113, 0x114, 0x115, 0x116, 0x117, 0x118, 0x119, 0x120, 0x121, 0x122, 0x123, 0x124, 0x125, // 4b0
+	0x120, 0x121, 0x122, 0x123, 0x124, 0x125, 0x126, 0x127, 0x128, 0x129, 0x130, 0x131, 0x132, 0x133, 0x134, 0x135, // 4c0
+	0x130, 0x131, 0x132, 0x133, 0x134, 0x135, 0x136, 0x137, 0x138, 0x139, 0x140, 0x141, 0x142, 0x143, 0x144, 0x145, // 4d0
+	0x140, 0x141, 0x142, 0x143, 0x144, 0x145, 0x146, 0x147, 0x148, 0x149, 0x150, 0x151, 0x152, 0x153, 0x154, 0x155, // 4e0
+	0x150, 0x151, 0x152, 0x153, 0x154, 0x155, 0x156, 0x157, 0x158, 0x159, 0x160, 0x161, 0x162, 0x163, 0x164, 0x165, // 4f0
+	0x1a0, 0x1a1, 0x1a2, 0x1a3, 0x1a4, 0x1a5, 0x1a6, 0x1a7, 0x1a8, 0x1a9, 0x1aa, 0x1ab, 0x1ac, 0x1ad, 0x1ae, 0x1af, // 500
+	0x1b0, 0x1b1, 0x1b2, 0x1b3, 0x1b4, 0x1b5, 0x1b6, 0x1b7, 0x1b8, 0x1b9, 0x1ba, 0x1bb, 0x1bc, 0x1bd, 0x1be, 0x1bf, // 510
+	0x1c0, 0x1c1, 0x1c2, 0x1c3, 0x1c4, 0x1c5, 0x1c6, 0x1c7, 0x1c8, 0x1c9, 0x1ca, 0x1cb, 0x1cc, 0x1cd, 0x1ce, 0x1cf, // 520
+	0x1d0, 0x1d1, 0x1d2, 0x1d3, 0x1d4, 0x1d5, 0x1d6, 0x1d7, 0x1d8, 0x1d9, 0x1da, 0x1db, 0x1dc, 0x1dd, 0x1de, 0x1df, // 530
+	0x1e0, 0x1e1, 0x1e2, 0x1e3, 0x1e4, 0x1e5, 0x1e6, 0x1e7, 0x1e8, 0x1e9, 0x1ea, 0x1eb, 0x1ec, 0x1ed, 0x1ee, 0x1ef, // 540
+	0x1f0, 0x1f1, 0x1f2, 0x1f3, 0x1f4, 0x1f5, 0x1f6, 0x1f7, 0x1f8, 0x1f9, 0x1fa, 0x1fb, 0x1fc, 0x1fd, 0x1fe, 0x1ff, // 550
+	0x100, 0x101, 0x102, 0x103, 0x104, 0x105, 0x106, 0x107, 0x108, 0x109, 0x10a, 0x10b, 0x10c, 0x10d, 0x10e, 0x10f, // 560
+	0x110, 0x111, 0x112, 0x113, 0x114, 0x115, 0x116, 0x117, 0x118, 0x119, 0x11a, 0x11b, 0x11c, 0x11d, 0x11e, 0x11f, // 570
+	0x120, 0x121, 0x122, 0x123, 0x124, 0x125, 0x126, 0x127, 0x128, 0x129, 0x12a, 0x12b, 0x12c, 0x12d, 0x12e, 0x12f, // 580
+	0x130, 0x131, 0x132, 0x133, 0x134, 0x135, 0x136, 0x137, 0x138, 0x139, 0x13a, 0x13b, 0x13c, 0x13d, 0x13e, 0x13f, // 590
+	0x140, 0x141, 0x142, 0x143, 0x144, 0x145, 0x146, 0x147, 0x148, 0x149, 0x14a, 0x14b, 0x14c, 0x14d, 0x14e, 0x14f, // 5a0
+	0x150, 0x151, 0x152, 0x153, 0x154, 0x155, 0x156, 0x157, 0x158, 0x159, 0x15a, 0x15b, 0x15c, 0x15d, 0x15e, 0x15f, // 5b0
+	0x160, 0x161, 0x162, 0x163, 0x164, 0x165, 0x166, 0x167, 0x168, 0x169, 0x16a, 0x16b, 0x16c, 0x16d, 0x16e, 0x16f, // 5c0
+	0x170, 0x171, 0x172, 0x173, 0x174, 0x175, 0x176, 0x177, 0x178, 0x179, 0x17a, 0x17b, 0x17c, 0x17d, 0x17e, 0x17f, // 5d0
+	0x180, 0x181, 0x182, 0x183, 0x184, 0x185, 0x186, 0x187, 0x188, 0x189, 0x18a, 0x18b, 0x18c, 0x18d, 0x18e, 0x18f, // 5e0
+	0x190, 0x191, 0x192, 0x193, 0x194, 0x195, 0x196, 0x197, 0x198, 0x199, 0x19a, 0x19b, 0x19c, 0x19d, 0x19e, 0x19f, // 5f0
+	0x166, 0x167, 0x168, 0x169, 0x16a, 0x16b, 0x16c, 0x16d, 0x16e, 0x16f, 0x170, 0x171, 0x172, 0x173, 0x174, 0x175, // 600
+	0x176, 0x177, 0x178, 0x179, 0x17a, 0x17b, 0x17c, 0x17d, 0x17e, 0x17f, 0x180, 0x181, 0x182, 0x183, 0x184, 0x185, // 610
+	0x186, 0x187, 0x188, 0x189, 0x18a, 0x18b, 0x18c, 0x18d, 0x18e, 0x18f, 0x190, 0x191, 0x192, 0x193, 0x194, 0x195, // 620
+	0x196, 0x197, 0x198, 0x199, 0x19a, 0x19b, 0x19c, 0x19d, 0x19e, 0x19f, 0x1a0, 0x1a1, 0x1a2, 0x1a3, 0x1a4, 0x1a5, // 630
+	0x1a6, 0x1a7, 0x1a8, 0x1a9, 0x1aa, 0x1ab, 0x1ac, 0x1ad, 0x1ae, 0x1af, 0x1b0, 0x1b1, 0x1b2, 0x1b3, 0x1b4, 0x1b5, // 640
+	0x1b6, 0x1b7, 0x1b8, 0x1b9, 0x1ba, 0x1bb, 0x1bc, 0x1bd, 0x1be, 0x1bf, 0x1c0, 0x1c1, 0x1c2, 0x1c3, 0x1c4, 0x1c5, // 650
+	0x1c6, 0x1c7, 0x1c8, 0x1c9, 0x1ca, 0x1cb, 0x1cc, 0x1cd, 0x1ce, 0x1cf, 0x1d0, 0x1d1, 0x1d2, 0x1d3, 0x1d4, 0x1d5, // 660
+	0x1d6, 0x1d7, 0x1d8, 0x1d9, 0x1da, 0x1db, 0x1dc, 0x1dd, 0x1de, 0x1df, 0x1e0, 0x1e1, 0x1e2, 0x1e3, 0x1e4, 0x1e5, // 670
+	0x1e6, 0x1e7, 0x1e8, 0x1e9, 0x1ea, 0x1eb, 0x1ec, 0x1ed, 0x1ee, 0x1ef, 0x1f0, 0x1f1, 0x1f2, 0x1f3, 0x1f4, 0x1f5, // 680
+	0x1f6, 0x1f7, 0x1f8, 0x1f9, 0x1fa, 0x1fb, 0x1fc, 0x1fd, 0x1fe, 0x1ff, 0x100, 0x101, 0x102, 0x103, 0x104, 0x105, // 690
+	0x106, 0x107, 0x108, 0x109, 0x10a, 0x10b, 0x10c, 0x10d, 0x10e, 0x10f, 0x110, 0x111, 0x112, 0x113, 0x114, 0x115, // 6a0
+	0x116, 0x117, 0x118, 0x119, 0x11a, 0x11b, 0x11c, 0x11d, 0x11e, 0x11f, 0x120, 0x121, 0x122, 0x123, 0x124, 0x125, // 6b0
+	0x126, 0x127, 0x128, 0x129, 0x12a, 0x12b, 0x12c, 0x12d, 0x12e, 0x12f, 0x130, 0x131, 0x132, 0x133, 0x134, 0x135, // 6c0
+	0x136, 0x137, 0x138, 0x139, 0x13a, 0x13b, 0x13c, 0x13d, 0x13e, 0x13f, 0x140, 0x141, 0x142, 0x143, 0x144, 0x145, // 6d0
+	0x146, 0x147, 0x148, 0x149, 0x14a, 0x14b, 0x14c, 0x14d, 0x14e, 0x14f, 0x150, 0x151, 0x152, 0x153, 0x154, 0x155, // 6e0
+	0x156, 0x157, 0x158, 0x159, 0x15a, 0x15b, 0x15c, 0x15d, 0x15e, 0x15f, 0x160, 0x161, 0x162, 0x163, 0x164, 0x165, // 6f0
+	0x19a, 0x19b, 0x19c, 0x19d, 0x19e, 0x19f, 0x1a0, 0x1a1, 0x1a2, 0x1a3, 0x1a4, 0x1a5, 0x1a6, 0x1a7, 0x1a8, 0x1a9, // 700
+	0x1aa, 0x1ab, 0x1ac, 0x1ad, 0x1ae, 0x1af, 0x1b0, 0x1b1, 0x1b2, 0x1b3, 0x1b4, 0x1b5, 0x1b6, 0x1b7, 0x1b8, 0x1b9, // 710
+	0x1ba, 0x1bb, 0x1bc, 0x1bd, 0x1be, 0x1bf, 0x1c0, 0x1c1, 0x1c2, 0x1c3, 0x1c4, 0x1c5, 0x1c6, 0x1c7, 0x1c8, 0x1c9, // 720
+	0x1ca, 0x1cb, 0x1cc, 0x1cd, 0x1ce, 0x1cf, 0x1d0, 0x1d1, 0x1d2, 0x1d3, 0x1d4, 0x1d5, 0x1d6, 0x1d7, 0x1d8, 0x1d9, // 730
+	0x1da, 0x1db, 0x1dc, 0x1dd, 0x1de, 0x1df, 0x1e0, 0x1e1, 0x1e2, 0x1e3, 0x1e4, 0x1e5, 0x1e6, 0x1e7, 0x1e8, 0x1e9, // 740
+	0x1ea, 0x1eb, 0x1ec, 0x1ed, 0x1ee, 0x1ef, 0x1f0, 0x1f1, 0x1f2, 0x1f3, 0x1f4, 0x1f5, 0x1f6, 0x1f7, 0x1f8, 0x1f9, // 750
+	0x1fa, 0x1fb, 0x1fc, 0x1fd, 0x1fe, 0x1ff, 0x100, 0x101, 0x102, 0x103, 0x104, 0x105, 0x106, 0x107, 0x108, 0x109, // 760
+	0x10a, 0x10b, 0x10c, 0x10d, 0x10e, 0x10f, 0x110, 0x111, 0x112, 0x113, 0x114, 0x115, 0x116, 0x117, 0x118, 0x119, // 770
+	0x11a, 0x11b, 0x11c, 0x11d, 0x11e, 0x11f, 0x120, 0x121, 0x122, 0x123, 0x124, 0x125, 0x126, 0x127, 0x128, 0x129, // 780
+	0x12a, 0x12b, 0x12c, 0x12d, 0x12e, 0x12f, 0x130, 0x131, 0x132, 0x133, 0x134, 0x135, 0x136, 0x137, 0x138, 0x139, // 790
+	0x13a, 0x13b, 0x13c, 0x13d, 0x13e, 0x13f, 0x140, 0x141, 0x142, 0x143, 0x144, 0x145, 0x146, 0x147, 0x148, 0x149, // 7a0
+	0x14a, 0x14b, 0x14c, 0x14d, 0x14e, 0x14f, 0x150, 0x151, 0x152, 0x153, 0x154, 0x155, 0x156, 0x157, 0x158, 0x159, // 7b0
+	0x15a, 0x15b, 0x15c, 0x15d, 0x15e, 0x15f, 0x160, 0x161, 0x162, 0x163, 0x164, 0x165, 0x166, 0x167, 0x168, 0x169, // 7c0
+	0x16a, 0x16b, 0x16c, 0x16d, 0x16e, 0x16f, 0x170, 0x171, 0x172, 0x173, 0x174, 0x175, 0x176, 0x177, 0x178, 0x179, // 7d0
+	0x17a, 0x17b, 0x17c, 0x17d, 0x17e, 0x17f, 0x180, 0x181, 0x182, 0x183, 0x184, 0x185, 0x186, 0x187, 0x188, 0x189, // 7e0
+	0x18a, 0x18b, 0x18c, 0x18d, 0x18e, 0x18f, 0x190, 0x191, 0x192, 0x193, 0x194, 0x195, 0x196, 0x197, 0x198, 0x199 // 7f0
+};
+
+/* 1 for instructions that can leave pc anywhere but the next instruction, or change interrupt state */
+
+static const uint8_t _instruction_ends_block[256] = {
+	//0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0
+	1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, // 1
+	1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, // 2
+	1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, // 3
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 4
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 5
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 6
+	0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 7
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 8
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 9
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // A
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // B
+	1, 0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 1, 1, 0, 1, // C
+	1, 0, 1, 1, 1, 0, 0, 1, 1, 1, 1, 1, 1, 1, 0, 1, // D
+	0, 0, 0, 1, 1, 0, 0, 1, 0, 1, 0, 1, 1, 1, 0, 1, // E
+	0, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 1, 1, 1, 0, 1  // F
+};
+
+/* 1 when the instruction can only change registers and flags, cb ops are checked separately */
+static const uint8_t _instruction_is_pure[256] = {
+	//0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+	1, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, // 0
+	0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 1
+	1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 2
+	1, 1, 0, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 3
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 4
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 5
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 6
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, // 7
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 8
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 9
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // A
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // B
+	1, 1, 1, 1, 0, 0, 1, 0, 1, 1, 1, 1, 0, 0, 1, 0, // C
+	1, 1, 1, 0, 0, 0, 1, 0, 1, 0, 1, 0, 0, 0, 1, 0, // D
+	0, 1, 0, 0, 0, 0, 1, 0, 1, 1, 0, 0, 0, 0, 1, 0, // E
+	1, 1, 1, 0, 0, 0, 1, 0, 1, 1, 1, 0, 0, 0, 1, 0  // F
+};
+
+void init_cpu(gb_cpu_t *cpu, gb_ppu_t *ppu, gb_cart_t *cart) {
 	for (int i = 0; i < 0x10000; i++) {
 		cpu->addressSpace[i] = 0;
 	}
 	cpu->ram = cpu->addressSpace + 0xC000;
 	cpu->ppu = ppu;
+	cpu->cart = cart;
+	cpu->boot_rom = NULL;
+	cpu->boot_mapped = 0;
 	cpu->instruction_wait_cycles = 0;
 	cpu->run_mode = 0;
 	cpu->halt = 0;
+	cpu->interrupts = 0;
+	cpu->ei_delay = 0;
 	cpu->pc = 0;
-
+	cpu->sp = 0;
+	cpu->render_from = 0;
+	cpu->trace = NULL;
+	cpu->recorder = NULL;
+	cpu->watchpoint_count = 0;
+	cpu->imm = 0;
+
+	cpu->jit = NULL;
+	cpu->block_invalidated = 0;
+	memset(cpu->code_lines, 0, sizeof(cpu->code_lines));
+	for (int i = 0; i < BLOCK_CACHE_SIZE; i++)
+		cpu->blocks[i].valid = 0;
+
+	init_mmu(cpu);
+	init_scheduler(&cpu->scheduler);
+	init_timer(&cpu->timer);
+	init_joypad(&cpu->joypad);
+	if (cart && cart->has_rtc)
+		schedule_event(&cpu->scheduler, GB_EVENT_RTC, CYCLES_PER_SECOND);
+
+	/* the low register of each pair comes first so the pairs read correctly on little endian hosts */
 	uint8_t *registers[] = {&cpu->a, &cpu->f, &cpu->b, &cpu->c, &cpu->d, &cpu->e, &cpu->h, &cpu->l};
-	cpu->af = (uint16_t *)&cpu->a;
-	cpu->bc = (uint16_t *)&cpu->b;
-	cpu->de = (uint16_t *)&cpu->d;
-	cpu->hl = (uint16_t *)&cpu->h;
-	uint8_t *cbreg[] = {&cpu->b, &cpu->c, &cpu->d, &cpu->e, &cpu->h, &cpu->l,(cpu->addressSpace + *cpu->hl), &cpu->a};
+	cpu->af = (uint16_t *)&cpu->f;
+	cpu->bc = (uint16_t *)&cpu->c;
+	cpu->de = (uint16_t *)&cpu->e;
+	cpu->hl = (uint16_t *)&cpu->l;
+	uint8_t *cbreg[] = {&cpu->b, &cpu->c, &cpu->d, &cpu->e, &cpu->h, &cpu->l, cpu->addressSpace, &cpu->a};
 	for (int i = 0; i < 8; i++) {
 		*registers[i] = 0;
 		cpu->registers[i] = cbreg[i];
 	}
+	load_flags(cpu);
 }
 
-uint32_t fetch_opcode(gb_cpu_t *cpu) {
-
-	/* 0 is either a nonexistant opcode or it indicates 
-	an opcode with a variable length cycle count, 
-	which is handled in the instruction implementation instead */
-
-	static uint8_t _instruction_cycle_count[16][16] = {
-		{4, 12, 8, 8, 4, 4, 8, 4, 20, 8, 8, 8, 4, 4, 8, 4},
-		{4, 12, 8, 8, 4, 4, 8, 4, 12, 8, 8, 8, 4, 4, 8, 4},
-		{0, 12, 8, 8, 4, 4, 8, 4, 0, 8, 8, 8, 4, 4, 8, 4},
-		{0, 12, 8, 8, 12, 12, 12, 4, 0, 8, 8, 8, 4, 4, 8, 4},
-		{4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4},
-		{4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4},
-		{4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4},
-		{4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 8, 4},
-		{4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4},
-		{4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4},
-		{4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4},
-		{4, 4, 4, 4, 4, 4, 8, 4, 4, 4, 4, 4, 4, 4, 8, 4},
-		{0, 12, 0, 16, 0, 16, 8, 16, 0, 16, 0, 4, 0, 24, 8, 16},
-		{0, 12, 0, 0, 0, 16, 8, 16, 0, 16, 0, 0, 0, 0, 8, 16},
-		{12, 12, 8, 0, 0, 16, 8, 16, 16, 4, 16, 0, 0, 0, 8, 16},
-		{12, 12, 8, 4, 0, 16, 8, 16, 12, 8, 16, 4, 0, 0, 8, 16}
-	};
-
-	static uint8_t _instruction_byte_size[16][16] = {
-		//0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
-		{1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1},
-		{1, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1},
-		{2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1},
-		{2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1},
-		{1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-		{1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-		{1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-		{1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-		{1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-		{1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-		{1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-		{1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-		{1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1},
-		{1, 1, 3, 0, 3, 1, 2, 1, 1, 1, 3, 0, 3, 0, 2, 1},
-		{2, 1, 1, 0, 0, 1, 2, 1, 2, 1, 3, 0, 0, 0, 3, 1},
-		{2, 1, 1, 1, 0, 1, 2, 1, 2, 1, 3, 1, 0, 0, 2, 1}
-	};
-	register uint8_t opcode = cpu->addressSpace[cpu->pc];
-	uint8_t opcodeHeader = opcode >> 4; // 0x0011
-	uint8_t opcodeFooter = opcode & 0xf;
-	uint8_t instructionSize = _instruction_byte_size[opcodeHeader][opcodeFooter];
-	cpu->instruction_wait_cycles = _instruction_cycle_count[opcodeHeader][opcodeFooter];
-	uint32_t final = opcode << 24; //0011 0000 0000 0000
-
-	if (instructionSize > 1) {
-		final |= instructionSize == 3 ? cpu->addressSpace[cpu->pc + 2] << 16 : cpu->addressSpace[cpu->pc + 1] << 16;
-		if (instructionSize > 2)
-			final |= cpu->addressSpace[cpu->pc + 1] << 8;
+/*
+ * flags are kept as the values they derive from and only turned into bits when read.
+ * z is set when flags.z is 0, h is bit 4 of flags.h and c is bit 8 of flags.c
+ */
+static inline bool get_flag_on(gb_cpu_t *cpu, uint8_t bit) {
+	switch (bit) {
+		case Z: return !cpu->flags.z;
+		case N: return cpu->flags.n;
+		case H: return (cpu->flags.h >> 4) & 1U;
+		default: return (cpu->flags.c >> 8) & 1U;
 	}
+}
 
-	cpu->pc += instructionSize;
-	return final;
+void sync_flags(gb_cpu_t *cpu) {
+	cpu->f = get_flag_on(cpu, Z) << Z | get_flag_on(cpu, N) << N | get_flag_on(cpu, H) << H | get_flag_on(cpu, C) << C;
 }
 
-void execute_instruction(gb_cpu_t *cpu, uint32_t instruction) {
-	if ((instruction & 0xff000000) == 0xcb000000)
-		_execute_prefix_instruction(cpu, (instruction & 0x00ff0000) >> 16);
-	else
-		_execute_instruction(cpu, instruction);
+void load_flags(gb_cpu_t *cpu) {
+	cpu->flags.z = !(cpu->f & (1 << Z));
+	cpu->flags.n = (cpu->f >> N) & 1U;
+	cpu->flags.h = (cpu->f >> (H - 4)) & 0x10;
+	cpu->flags.c = (cpu->f << (8 - C)) & 0x100;
 }
 
-static inline void set_flag(gb_cpu_t *cpu, uint8_t bit, bool status) {
-	cpu->f ^= (-status ^ cpu->f) & (1UL << bit);	
+static inline bool get_bit_on(uint8_t value, uint8_t bit) {
+	return (value >> bit) & 1U;
 }
-static inline void set_bit_on(uint8_t value, uint8_t bit, bool status) {
-	value ^= (-status ^ value) & (1UL << bit);	
+
+static inline uint8_t _read8(gb_cpu_t *cpu, uint16_t address) {
+	const uint8_t *page = cpu->mmu.read[address >> MMU_PAGE_SHIFT];
+	if (page)
+		return page[address & (MMU_PAGE_SIZE - 1)];
+	return cpu->mmu.read_handler[address >> MMU_PAGE_SHIFT](cpu, address);
 }
-static inline bool get_flag_on(gb_cpu_t *cpu, uint8_t bit) {
-	return (cpu->f >> bit) & 1U;
+
+static inline void _write8(gb_cpu_t *cpu, uint16_t address, uint8_t value) {
+	uint8_t *page = cpu->mmu.write[address >> MMU_PAGE_SHIFT];
+	if (page) {
+		page[address & (MMU_PAGE_SIZE - 1)] = value;
+		return;
+	}
+	if (cpu->mmu.watched[address >> MMU_PAGE_SHIFT])
+		check_watchpoints(cpu, address);
+	cpu->mmu.write_handler[address >> MMU_PAGE_SHIFT](cpu, address, value);
 }
 
-static inline bool get_bit_on(uint8_t value, uint8_t bit) {
-	return (value >> bit) & 1U;
+/* operands are predecoded along with the opcode, pc is already past them when the handler runs */
+static inline uint8_t _imm8(gb_cpu_t *cpu) {
+	return cpu->imm;
+}
+
+static inline uint16_t _imm16(gb_cpu_t *cpu) {
+	return cpu->imm;
+}
+
+static inline void _push16(gb_cpu_t *cpu, uint16_t value) {
+	_write8(cpu, --cpu->sp, value >> 8);
+	_write8(cpu, --cpu->sp, value & 0xff);
+}
+
+static inline uint16_t _pop16(gb_cpu_t *cpu) {
+	uint16_t low = _read8(cpu, cpu->sp++);
+	return low | (_read8(cpu, cpu->sp++) << 8);
+}
+
+/* alu */
+
+/* a ^ b ^ result has the carry into each bit, for subtraction too, so bit 4 is the half carry */
+
+static inline uint8_t _inc8(gb_cpu_t *cpu, uint8_t value) {
+	uint8_t result = value + 1;
+	cpu->flags.z = result;
+	cpu->flags.n = 0;
+	cpu->flags.h = value ^ 1 ^ result;
+	return result;
+}
+
+static inline uint8_t _dec8(gb_cpu_t *cpu, uint8_t value) {
+	uint8_t result = value - 1;
+	cpu->flags.z = result;
+	cpu->flags.n = 1;
+	cpu->flags.h = value ^ 1 ^ result;
+	return result;
+}
+
+static inline void _add8(gb_cpu_t *cpu, uint8_t value, bool carry) {
+	uint16_t result = cpu->a + value + carry;
+	cpu->flags.z = result;
+	cpu->flags.n = 0;
+	cpu->flags.h = cpu->a ^ value ^ result;
+	cpu->flags.c = result;
+	cpu->a = result;
+}
+
+/* a borrow leaves the result negative, which sets bit 8 just like a carry would */
+static inline uint8_t _sub8(gb_cpu_t *cpu, uint8_t value, bool carry) {
+	uint16_t result = cpu->a - value - carry;
+	cpu->flags.z = result;
+	cpu->flags.n = 1;
+	cpu->flags.h = cpu->a ^ value ^ result;
+	cpu->flags.c = result;
+	return result;
+}
+
+static inline void _logic_flags(gb_cpu_t *cpu, uint16_t half_carry) {
+	cpu->flags.z = cpu->a;
+	cpu->flags.n = 0;
+	cpu->flags.h = half_carry;
+	cpu->flags.c = 0;
+}
+
+static inline void _and8(gb_cpu_t *cpu, uint8_t value) {
+	cpu->a &= value;
+	_logic_flags(cpu, 0x10);
+}
+
+static inline void _xor8(gb_cpu_t *cpu, uint8_t value) {
+	cpu->a ^= value;
+	_logic_flags(cpu, 0);
+}
+
+static inline void _or8(gb_cpu_t *cpu, uint8_t value) {
+	cpu->a |= value;
+	_logic_flags(cpu, 0);
+}
+
+static inline void _add16(gb_cpu_t *cpu, uint16_t value) {
+	uint32_t result = *cpu->hl + value;
+	// the 16 bit carries sit 8 bits higher than the 8 bit ones
+	cpu->flags.n = 0;
+	cpu->flags.h = (*cpu->hl ^ value ^ result) >> 8;
+	cpu->flags.c = result >> 8;
+	*cpu->hl = result;
+}
+
+static inline uint16_t _add_sp(gb_cpu_t *cpu, int8_t offset) {
+	uint16_t low = (cpu->sp & 0xff) + (uint8_t)offset;
+	cpu->flags.z = 1;
+	cpu->flags.n = 0;
+	cpu->flags.h = cpu->sp ^ (uint8_t)offset ^ low;
+	cpu->flags.c = low;
+	return cpu->sp + offset;
+}
+
+static inline void _daa(gb_cpu_t *cpu) {
+	uint16_t adjusted = _daa_table[cpu->a | cpu->flags.n << 8 | get_flag_on(cpu, H) << 9 | get_flag_on(cpu, C) << 10];
+	cpu->a = adjusted;
+	cpu->flags.z = cpu->a;
+	cpu->flags.h = 0;
+	cpu->flags.c = adjusted & 0x100;
+}
+
+/* rotates and shifts, shared by the accumulator forms and the cb prefix */
+
+static inline uint8_t _shift_flags(gb_cpu_t *cpu, uint8_t value, bool carry) {
+	cpu->flags.z = value;
+	cpu->flags.n = 0;
+	cpu->flags.h = 0;
+	cpu->flags.c = carry << 8;
+	return value;
+}
+
+static inline uint8_t _rlc(gb_cpu_t *cpu, uint8_t value) {
+	return _shift_flags(cpu, (value << 1) | (value >> 7), get_bit_on(value, 7));
+}
+
+static inline uint8_t _rrc(gb_cpu_t *cpu, uint8_t value) {
+	return _shift_flags(cpu, (value >> 1) | (value << 7), get_bit_on(value, 0));
+}
+
+static inline uint8_t _rl(gb_cpu_t *cpu, uint8_t value) {
+	return _shift_flags(cpu, (value << 1) | get_flag_on(cpu, C), get_bit_on(value, 7));
+}
+
+static inline uint8_t _rr(gb_cpu_t *cpu, uint8_t value) {
+	return _shift_flags(cpu, (value >> 1) | (get_flag_on(cpu, C) << 7), get_bit_on(value, 0));
+}
+
+static inline uint8_t _sla(gb_cpu_t *cpu, uint8_t value) {
+	return _shift_flags(cpu, value << 1, get_bit_on(value, 7));
+}
+
+static inline uint8_t _sra(gb_cpu_t *cpu, uint8_t value) {
+	return _shift_flags(cpu, (value >> 1) | (value & 0x80), get_bit_on(value, 0));
+}
+
+static inline uint8_t _swap(gb_cpu_t *cpu, uint8_t value) {
+	return _shift_flags(cpu, (value << 4) | (value >> 4), 0);
+}
+
+static inline uint8_t _srl(gb_cpu_t *cpu, uint8_t value) {
+	return _shift_flags(cpu, value >> 1, get_bit_on(value, 0));
+}
+
+static inline void _bit(gb_cpu_t *cpu, uint8_t value, uint8_t bit) {
+	cpu->flags.z = value & (1 << bit);
+	cpu->flags.n = 0;
+	cpu->flags.h = 0x10;
+}
+
+/* control flow, conditional forms set their own cycle count */
+
+static inline void _jr(gb_cpu_t *cpu, bool condition) {
+	int8_t offset = (int8_t)_imm8(cpu);
+	if (condition) {
+		cpu->pc += offset;
+		cpu->instruction_wait_cycles = 12;
+	} else {
+		cpu->instruction_wait_cycles = 8;
+	}
+}
+
+static inline void _jp(gb_cpu_t *cpu, bool condition) {
+	uint16_t address = _imm16(cpu);
+	if (condition) {
+		cpu->pc = address;
+		cpu->instruction_wait_cycles = 16;
+	} else {
+		cpu->instruction_wait_cycles = 12;
+	}
+}
+
+static inline void _call(gb_cpu_t *cpu, bool condition) {
+	uint16_t address = _imm16(cpu);
+	if (condition) {
+		_push16(cpu, cpu->pc);
+		cpu->pc = address;
+		cpu->instruction_wait_cycles = 24;
+	} else {
+		cpu->instruction_wait_cycles = 12;
+	}
+}
+
+static inline void _ret(gb_cpu_t *cpu, bool condition) {
+	if (condition) {
+		cpu->pc = _pop16(cpu);
+		cpu->instruction_wait_cycles = 20;
+	} else {
+		cpu->instruction_wait_cycles = 8;
+	}
+}
+
+static inline void _rst(gb_cpu_t *cpu, uint16_t address) {
+	_push16(cpu, cpu->pc);
+	cpu->pc = address;
+}
+
+/* 0x00 - 0x3f */
+
+static void _nop(gb_cpu_t *cpu) {}
+
+static void _illegal(gb_cpu_t *cpu) {
+	// the cpu locks up on nonexistant opcodes
+	cpu->pc--;
+	if (cpu->recorder)
+		flight_dump(cpu->recorder, "illegal opcode");
+}
+
+static void _ld_bc_d16(gb_cpu_t *cpu) { *cpu->bc = _imm16(cpu); }
+static void _ld_de_d16(gb_cpu_t *cpu) { *cpu->de = _imm16(cpu); }
+static void _ld_hl_d16(gb_cpu_t *cpu) { *cpu->hl = _imm16(cpu); }
+static void _ld_sp_d16(gb_cpu_t *cpu) { cpu->sp = _imm16(cpu); }
+
+static void _ld_mbc_a(gb_cpu_t *cpu) { _write8(cpu, *cpu->bc, cpu->a); }
+static void _ld_mde_a(gb_cpu_t *cpu) { _write8(cpu, *cpu->de, cpu->a); }
+static void _ld_mhli_a(gb_cpu_t *cpu) { _write8(cpu, (*cpu->hl)++, cpu->a); }
+static void _ld_mhld_a(gb_cpu_t *cpu) { _write8(cpu, (*cpu->hl)--, cpu->a); }
+static void _ld_a_mbc(gb_cpu_t *cpu) { cpu->a = _read8(cpu, *cpu->bc); }
+static void _ld_a_mde(gb_cpu_t *cpu) { cpu->a = _read8(cpu, *cpu->de); }
+static void _ld_a_mhli(gb_cpu_t *cpu) { cpu->a = _read8(cpu, (*cpu->hl)++); }
+static void _ld_a_mhld(gb_cpu_t *cpu) { cpu->a = _read8(cpu, (*cpu->hl)--); }
+
+static void _inc_bc(gb_cpu_t *cpu) { (*cpu->bc)++; }
+static void _inc_de(gb_cpu_t *cpu) { (*cpu->de)++; }
+static void _inc_hl(gb_cpu_t *cpu) { (*cpu->hl)++; }
+static void _inc_sp(gb_cpu_t *cpu) { cpu->sp++; }
+static void _dec_bc(gb_cpu_t *cpu) { (*cpu->bc)--; }
+static void _dec_de(gb_cpu_t *cpu) { (*cpu->de)--; }
+static void _dec_hl(gb_cpu_t *cpu) { (*cpu->hl)--; }
+static void _dec_sp(gb_cpu_t *cpu) { cpu->sp--; }
+
+static void _add_hl_bc(gb_cpu_t *cpu) { _add16(cpu, *cpu->bc); }
+static void _add_hl_de(gb_cpu_t *cpu) { _add16(cpu, *cpu->de); }
+static void _add_hl_hl(gb_cpu_t *cpu) { _add16(cpu, *cpu->hl); }
+static void _add_hl_sp(gb_cpu_t *cpu) { _add16(cpu, cpu->sp); }
+
+#define REG8_OPS(r) \
+	static void _inc_##r(gb_cpu_t *cpu) { cpu->r = _inc8(cpu, cpu->r); } \
+	static void _dec_##r(gb_cpu_t *cpu) { cpu->r = _dec8(cpu, cpu->r); }
+
+REG8_OPS(b)
+REG8_OPS(c)
+REG8_OPS(d)
+REG8_OPS(e)
+REG8_OPS(h)
+REG8_OPS(l)
+REG8_OPS(a)
+
+static void _inc_mhl(gb_cpu_t *cpu) { _write8(cpu, *cpu->hl, _inc8(cpu, _read8(cpu, *cpu->hl))); }
+static void _dec_mhl(gb_cpu_t *cpu) { _write8(cpu, *cpu->hl, _dec8(cpu, _read8(cpu, *cpu->hl))); }
+static void _ld_mhl_d8(gb_cpu_t *cpu) { _write8(cpu, *cpu->hl, _imm8(cpu)); }
+
+static void _rlca(gb_cpu_t *cpu) { cpu->a = _rlc(cpu, cpu->a); cpu->flags.z = 1; }
+static void _rrca(gb_cpu_t *cpu) { cpu->a = _rrc(cpu, cpu->a); cpu->flags.z = 1; }
+static void _rla(gb_cpu_t *cpu) { cpu->a = _rl(cpu, cpu->a); cpu->flags.z = 1; }
+static void _rra(gb_cpu_t *cpu) { cpu->a = _rr(cpu, cpu->a); cpu->flags.z = 1; }
+
+static void _ld_ma16_sp(gb_cpu_t *cpu) {
+	uint16_t address = _imm16(cpu);
+	_write8(cpu, address, cpu->sp & 0xff);
+	_write8(cpu, address + 1, cpu->sp >> 8);
 }
 
-static void _stop() {
+static void _stop(gb_cpu_t *cpu) {
 	//halt cpu & lcd display until button pressed
-	for (;;) {
+	cpu->halt = 1;
+}
+
+static void _jr_r8(gb_cpu_t *cpu) { _jr(cpu, 1); }
+static void _jr_nz(gb_cpu_t *cpu) { _jr(cpu, !get_flag_on(cpu, Z)); }
+static void _jr_z(gb_cpu_t *cpu) { _jr(cpu, get_flag_on(cpu, Z)); }
+static void _jr_nc(gb_cpu_t *cpu) { _jr(cpu, !get_flag_on(cpu, C)); }
+static void _jr_c(gb_cpu_t *cpu) { _jr(cpu, get_flag_on(cpu, C)); }
+
+static void _daa_a(gb_cpu_t *cpu) { _daa(cpu); }
+
+static void _cpl(gb_cpu_t *cpu) {
+	cpu->a = ~cpu->a;
+	cpu->flags.n = 1;
+	cpu->flags.h = 0x10;
+}
 
+static void _scf(gb_cpu_t *cpu) {
+	cpu->flags.n = 0;
+	cpu->flags.h = 0;
+	cpu->flags.c = 0x100;
+}
+
+static void _ccf(gb_cpu_t *cpu) {
+	cpu->flags.n = 0;
+	cpu->flags.h = 0;
+	cpu->flags.c ^= 0x100;
+}
+
+/* 0x40 - 0xbf, plus the d8 alu forms, one handler per source operand */
+
+#define SRC_OPS(src, value) \
+	static void _ld_b_##src(gb_cpu_t *cpu) { cpu->b = value; } \
+	static void _ld_c_##src(gb_cpu_t *cpu) { cpu->c = value; } \
+	static void _ld_d_##src(gb_cpu_t *cpu) { cpu->d = value; } \
+	static void _ld_e_##src(gb_cpu_t *cpu) { cpu->e = value; } \
+	static void _ld_h_##src(gb_cpu_t *cpu) { cpu->h = value; } \
+	static void _ld_l_##src(gb_cpu_t *cpu) { cpu->l = value; } \
+	static void _ld_a_##src(gb_cpu_t *cpu) { cpu->a = value; } \
+	static void _add_a_##src(gb_cpu_t *cpu) { _add8(cpu, value, 0); } \
+	static void _adc_a_##src(gb_cpu_t *cpu) { _add8(cpu, value, get_flag_on(cpu, C)); } \
+	static void _sub_##src(gb_cpu_t *cpu) { cpu->a = _sub8(cpu, value, 0); } \
+	static void _sbc_a_##src(gb_cpu_t *cpu) { cpu->a = _sub8(cpu, value, get_flag_on(cpu, C)); } \
+	static void _and_##src(gb_cpu_t *cpu) { _and8(cpu, value); } \
+	static void _xor_##src(gb_cpu_t *cpu) { _xor8(cpu, value); } \
+	static void _or_##src(gb_cpu_t *cpu) { _or8(cpu, value); } \
+	static void _cp_##src(gb_cpu_t *cpu) { _sub8(cpu, value, 0); }
+
+SRC_OPS(b, cpu->b)
+SRC_OPS(c, cpu->c)
+SRC_OPS(d, cpu->d)
+SRC_OPS(e, cpu->e)
+SRC_OPS(h, cpu->h)
+SRC_OPS(l, cpu->l)
+SRC_OPS(a, cpu->a)
+SRC_OPS(mhl, _read8(cpu, *cpu->hl))
+SRC_OPS(d8, _imm8(cpu))
+
+static void _ld_mhl_b(gb_cpu_t *cpu) { _write8(cpu, *cpu->hl, cpu->b); }
+static void _ld_mhl_c(gb_cpu_t *cpu) { _write8(cpu, *cpu->hl, cpu->c); }
+static void _ld_mhl_d(gb_cpu_t *cpu) { _write8(cpu, *cpu->hl, cpu->d); }
+static void _ld_mhl_e(gb_cpu_t *cpu) { _write8(cpu, *cpu->hl, cpu->e); }
+static void _ld_mhl_h(gb_cpu_t *cpu) { _write8(cpu, *cpu->hl, cpu->h); }
+static void _ld_mhl_l(gb_cpu_t *cpu) { _write8(cpu, *cpu->hl, cpu->l); }
+static void _ld_mhl_a(gb_cpu_t *cpu) { _write8(cpu, *cpu->hl, cpu->a); }
+
+static void _halt(gb_cpu_t *cpu) {
+	cpu->halt = 1;
+}
+
+/* 0xc0 - 0xff */
+
+static void _ret_nz(gb_cpu_t *cpu) { _ret(cpu, !get_flag_on(cpu, Z)); }
+static void _ret_z(gb_cpu_t *cpu) { _ret(cpu, get_flag_on(cpu, Z)); }
+static void _ret_nc(gb_cpu_t *cpu) { _ret(cpu, !get_flag_on(cpu, C)); }
+static void _ret_c(gb_cpu_t *cpu) { _ret(cpu, get_flag_on(cpu, C)); }
+static void _ret_always(gb_cpu_t *cpu) { cpu->pc = _pop16(cpu); }
+
+static void _reti(gb_cpu_t *cpu) {
+	cpu->pc = _pop16(cpu);
+	cpu->interrupts = 1;
+}
+
+static void _jp_nz(gb_cpu_t *cpu) { _jp(cpu, !get_flag_on(cpu, Z)); }
+static void _jp_z(gb_cpu_t *cpu) { _jp(cpu, get_flag_on(cpu, Z)); }
+static void _jp_nc(gb_cpu_t *cpu) { _jp(cpu, !get_flag_on(cpu, C)); }
+static void _jp_c(gb_cpu_t *cpu) { _jp(cpu, get_flag_on(cpu, C)); }
+static void _jp_a16(gb_cpu_t *cpu) { cpu->pc = _imm16(cpu); }
+static void _jp_hl(gb_cpu_t *cpu) { cpu->pc = *cpu->hl; }
+
+static void _call_nz(gb_cpu_t *cpu) { _call(cpu, !get_flag_on(cpu, Z)); }
+static void _call_z(gb_cpu_t *cpu) { _call(cpu, get_flag_on(cpu, Z)); }
+static void _call_nc(gb_cpu_t *cpu) { _call(cpu, !get_flag_on(cpu, C)); }
+static void _call_c(gb_cpu_t *cpu) { _call(cpu, get_flag_on(cpu, C)); }
+static void _call_a16(gb_cpu_t *cpu) { _call(cpu, 1); }
+
+static void _pop_bc(gb_cpu_t *cpu) { *cpu->bc = _pop16(cpu); }
+static void _pop_de(gb_cpu_t *cpu) { *cpu->de = _pop16(cpu); }
+static void _pop_hl(gb_cpu_t *cpu) { *cpu->hl = _pop16(cpu); }
+static void _pop_af(gb_cpu_t *cpu) { *cpu->af = _pop16(cpu) & 0xfff0; load_flags(cpu); }
+static void _push_bc(gb_cpu_t *cpu) { _push16(cpu, *cpu->bc); }
+static void _push_de(gb_cpu_t *cpu) { _push16(cpu, *cpu->de); }
+static void _push_hl(gb_cpu_t *cpu) { _push16(cpu, *cpu->hl); }
+static void _push_af(gb_cpu_t *cpu) { sync_flags(cpu); _push16(cpu, *cpu->af); }
+
+static void _rst_00(gb_cpu_t *cpu) { _rst(cpu, 0x00); }
+static void _rst_08(gb_cpu_t *cpu) { _rst(cpu, 0x08); }
+static void _rst_10(gb_cpu_t *cpu) { _rst(cpu, 0x10); }
+static void _rst_18(gb_cpu_t *cpu) { _rst(cpu, 0x18); }
+static void _rst_20(gb_cpu_t *cpu) { _rst(cpu, 0x20); }
+static void _rst_28(gb_cpu_t *cpu) { _rst(cpu, 0x28); }
+static void _rst_30(gb_cpu_t *cpu) { _rst(cpu, 0x30); }
+static void _rst_38(gb_cpu_t *cpu) { _rst(cpu, 0x38); }
+
+static void _ldh_ma8_a(gb_cpu_t *cpu) { _write8(cpu, 0xff00 + _imm8(cpu), cpu->a); }
+static void _ldh_a_ma8(gb_cpu_t *cpu) { cpu->a = _read8(cpu, 0xff00 + _imm8(cpu)); }
+static void _ld_mc_a(gb_cpu_t *cpu) { _write8(cpu, 0xff00 + cpu->c, cpu->a); }
+static void _ld_a_mc(gb_cpu_t *cpu) { cpu->a = _read8(cpu, 0xff00 + cpu->c); }
+static void _ld_ma16_a(gb_cpu_t *cpu) { _write8(cpu, _imm16(cpu), cpu->a); }
+static void _ld_a_ma16(gb_cpu_t *cpu) { cpu->a = _read8(cpu, _imm16(cpu)); }
+
+static void _add_sp_r8(gb_cpu_t *cpu) { cpu->sp = _add_sp(cpu, (int8_t)_imm8(cpu)); }
+static void _ld_hl_sp_r8(gb_cpu_t *cpu) { *cpu->hl = _add_sp(cpu, (int8_t)_imm8(cpu)); }
+static void _ld_sp_hl(gb_cpu_t *cpu) { cpu->sp = *cpu->hl; }
+
+static void _di(gb_cpu_t *cpu) {
+	cpu->interrupts = 0;
+	cpu->ei_delay = 0;
+}
+
+// takes effect after the next instruction, see run_until
+static void _ei(gb_cpu_t *cpu) { cpu->ei_delay = 1; }
+
+static void _prefix(gb_cpu_t *cpu);
+
+// https://www.pastraiser.com/cpu/gameboy/gameboy_opcodes.html
+static const gb_opcode_t _opcodes[256] = {
+	/* 0 */ _nop, _ld_bc_d16, _ld_mbc_a, _inc_bc, _inc_b, _dec_b, _ld_b_d8, _rlca, _ld_ma16_sp, _add_hl_bc, _ld_a_mbc, _dec_bc, _inc_c, _dec_c, _ld_c_d8, _rrca,
+	/* 1 */ _stop, _ld_de_d16, _ld_mde_a, _inc_de, _inc_d, _dec_d, _ld_d_d8, _rla, _jr_r8, _add_hl_de, _ld_a_mde, _dec_de, _inc_e, _dec_e, _ld_e_d8, _rra,
+	/* 2 */ _jr_nz, _ld_hl_d16, _ld_mhli_a, _inc_hl, _inc_h, _dec_h, _ld_h_d8, _daa_a, _jr_z, _add_hl_hl, _ld_a_mhli, _dec_hl, _inc_l, _dec_l, _ld_l_d8, _cpl,
+	/* 3 */ _jr_nc, _ld_sp_d16, _ld_mhld_a, _inc_sp, _inc_mhl, _dec_mhl, _ld_mhl_d8, _scf, _jr_c, _add_hl_sp, _ld_a_mhld, _dec_sp, _inc_a, _dec_a, _ld_a_d8, _ccf,
+	/* 4 */ _ld_b_b, _ld_b_c, _ld_b_d, _ld_b_e, _ld_b_h, _ld_b_l, _ld_b_mhl, _ld_b_a, _ld_c_b, _ld_c_c, _ld_c_d, _ld_c_e, _ld_c_h, _ld_c_l, _ld_c_mhl, _ld_c_a,
+	/* 5 */ _ld_d_b, _ld_d_c, _ld_d_d, _ld_d_e, _ld_d_h, _ld_d_l, _ld_d_mhl, _ld_d_a, _ld_e_b, _ld_e_c, _ld_e_d, _ld_e_e, _ld_e_h, _ld_e_l, _ld_e_mhl, _ld_e_a,
+	/* 6 */ _ld_h_b, _ld_h_c, _ld_h_d, _ld_h_e, _ld_h_h, _ld_h_l, _ld_h_mhl, _ld_h_a, _ld_l_b, _ld_l_c, _ld_l_d, _ld_l_e, _ld_l_h, _ld_l_l, _ld_l_mhl, _ld_l_a,
+	/* 7 */ _ld_mhl_b, _ld_mhl_c, _ld_mhl_d, _ld_mhl_e, _ld_mhl_h, _ld_mhl_l, _halt, _ld_mhl_a, _ld_a_b, _ld_a_c, _ld_a_d, _ld_a_e, _ld_a_h, _ld_a_l, _ld_a_mhl, _ld_a_a,
+	/* 8 */ _add_a_b, _add_a_c, _add_a_d, _add_a_e, _add_a_h, _add_a_l, _add_a_mhl, _add_a_a, _adc_a_b, _adc_a_c, _adc_a_d, _adc_a_e, _adc_a_h, _adc_a_l, _adc_a_mhl, _adc_a_a,
+	/* 9 */ _sub_b, _sub_c, _sub_d, _sub_e, _sub_h, _sub_l, _sub_mhl, _sub_a, _sbc_a_b, _sbc_a_c, _sbc_a_d, _sbc_a_e, _sbc_a_h, _sbc_a_l, _sbc_a_mhl, _sbc_a_a,
+	/* A */ _and_b, _and_c, _and_d, _and_e, _and_h, _and_l, _and_mhl, _and_a, _xor_b, _xor_c, _xor_d, _xor_e, _xor_h, _xor_l, _xor_mhl, _xor_a,
+	/* B */ _or_b, _or_c, _or_d, _or_e, _or_h, _or_l, _or_mhl, _or_a, _cp_b, _cp_c, _cp_d, _cp_e, _cp_h, _cp_l, _cp_mhl, _cp_a,
+	/* C */ _ret_nz, _pop_bc, _jp_nz, _jp_a16, _call_nz, _push_bc, _add_a_d8, _rst_00, _ret_z, _ret_always, _jp_z, _prefix, _call_z, _call_a16, _adc_a_d8, _rst_08,
+	/* D */ _ret_nc, _pop_de, _jp_nc, _illegal, _call_nc, _push_de, _sub_d8, _rst_10, _ret_c, _reti, _jp_c, _illegal, _call_c, _illegal, _sbc_a_d8, _rst_18,
+	/* E */ _ldh_ma8_a, _pop_hl, _ld_mc_a, _illegal, _illegal, _push_hl, _and_d8, _rst_20, _add_sp_r8, _jp_hl, _ld_ma16_a, _illegal, _illegal, _illegal, _xor_d8, _rst_28,
+	/* F */ _ldh_a_ma8, _pop_af, _ld_a_mc, _di, _illegal, _push_af, _or_d8, _rst_30, _ld_hl_sp_r8, _ld_sp_hl, _ld_a_ma16, _ei, _illegal, _illegal, _cp_d8, _rst_38
+};
+
+/* cb prefix, every row is the same operation on b, c, d, e, h, l, (hl), a */
+
+#define CB_OPS(name, expr) \
+	static void _##name##_b(gb_cpu_t *cpu) { uint8_t value = cpu->b; cpu->b = expr; } \
+	static void _##name##_c(gb_cpu_t *cpu) { uint8_t value = cpu->c; cpu->c = expr; } \
+	static void _##name##_d(gb_cpu_t *cpu) { uint8_t value = cpu->d; cpu->d = expr; } \
+	static void _##name##_e(gb_cpu_t *cpu) { uint8_t value = cpu->e; cpu->e = expr; } \
+	static void _##name##_h(gb_cpu_t *cpu) { uint8_t value = cpu->h; cpu->h = expr; } \
+	static void _##name##_l(gb_cpu_t *cpu) { uint8_t value = cpu->l; cpu->l = expr; } \
+	static void _##name##_mhl(gb_cpu_t *cpu) { uint8_t value = _read8(cpu, *cpu->hl); _write8(cpu, *cpu->hl, expr); } \
+	static void _##name##_a(gb_cpu_t *cpu) { uint8_t value = cpu->a; cpu->a = expr; }
+
+#define CB_BIT_OPS(bit) \
+	static void _bit##bit##_b(gb_cpu_t *cpu) { _bit(cpu, cpu->b, bit); } \
+	static void _bit##bit##_c(gb_cpu_t *cpu) { _bit(cpu, cpu->c, bit); } \
+	static void _bit##bit##_d(gb_cpu_t *cpu) { _bit(cpu, cpu->d, bit); } \
+	static void _bit##bit##_e(gb_cpu_t *cpu) { _bit(cpu, cpu->e, bit); } \
+	static void _bit##bit##_h(gb_cpu_t *cpu) { _bit(cpu, cpu->h, bit); } \
+	static void _bit##bit##_l(gb_cpu_t *cpu) { _bit(cpu, cpu->l, bit); } \
+	static void _bit##bit##_mhl(gb_cpu_t *cpu) { _bit(cpu, _read8(cpu, *cpu->hl), bit); } \
+	static void _bit##bit##_a(gb_cpu_t *cpu) { _bit(cpu, cpu->a, bit); } \
+	CB_OPS(res##bit, value & ~(1 << bit)) \
+	CB_OPS(set##bit, value | (1 << bit))
+
+#define CB_ROW(name) _##name##_b, _##name##_c, _##name##_d, _##name##_e, _##name##_h, _##name##_l, _##name##_mhl, _##name##_a
+
+CB_OPS(rlc, _rlc(cpu, value))
+CB_OPS(rrc, _rrc(cpu, value))
+CB_OPS(rl, _rl(cpu, value))
+CB_OPS(rr, _rr(cpu, value))
+CB_OPS(sla, _sla(cpu, value))
+CB_OPS(sra, _sra(cpu, value))
+CB_OPS(swap, _swap(cpu, value))
+CB_OPS(srl, _srl(cpu, value))
+CB_BIT_OPS(0)
+CB_BIT_OPS(1)
+CB_BIT_OPS(2)
+CB_BIT_OPS(3)
+CB_BIT_OPS(4)
+CB_BIT_OPS(5)
+CB_BIT_OPS(6)
+CB_BIT_OPS(7)
+
+static const gb_opcode_t _prefix_opcodes[256] = {
+	/* 0 */ CB_ROW(rlc), CB_ROW(rrc),
+	/* 1 */ CB_ROW(rl), CB_ROW(rr),
+	/* 2 */ CB_ROW(sla), CB_ROW(sra),
+	/* 3 */ CB_ROW(swap), CB_ROW(srl),
+	/* 4 */ CB_ROW(bit0), CB_ROW(bit1),
+	/* 5 */ CB_ROW(bit2), CB_ROW(bit3),
+	/* 6 */ CB_ROW(bit4), CB_ROW(bit5),
+	/* 7 */ CB_ROW(bit6), CB_ROW(bit7),
+	/* 8 */ CB_ROW(res0), CB_ROW(res1),
+	/* 9 */ CB_ROW(res2), CB_ROW(res3),
+	/* A */ CB_ROW(res4), CB_ROW(res5),
+	/* B */ CB_ROW(res6), CB_ROW(res7),
+	/* C */ CB_ROW(set0), CB_ROW(set1),
+	/* D */ CB_ROW(set2), CB_ROW(set3),
+	/* E */ CB_ROW(set4), CB_ROW(set5),
+	/* F */ CB_ROW(set6), CB_ROW(set7)
+};
+
+static inline uint8_t _prefix_cycle_count(uint8_t opcode) {
+	if ((opcode & 0x7) == 0x6)
+		return (opcode & 0xc0) == 0x40 ? 12 : 16;
+	return 8;
+}
+
+static void _prefix(gb_cpu_t *cpu) {
+	uint8_t opcode = _imm8(cpu);
+	cpu->instruction_wait_cycles = _prefix_cycle_count(opcode);
+	_prefix_opcodes[opcode](cpu);
+}
+
+static inline void _decode(gb_cpu_t *cpu, uint16_t pc, gb_decoded_t *decoded) {
+	uint8_t opcode = _read8(cpu, pc);
+	uint8_t instructionSize = _instruction_byte_size[opcode];
+
+	decoded->handler = _opcodes[opcode];
+	decoded->opcode = opcode;
+	decoded->cycles = _instruction_cycle_count[opcode];
+	// nonexistant opcodes still occupy one byte, the handler steps pc back onto it
+	decoded->length = instructionSize ? instructionSize : 1;
+	decoded->imm = 0;
+	if (instructionSize > 1)
+		decoded->imm = _read8(cpu, pc + 1);
+	if (instructionSize > 2)
+		decoded->imm |= _read8(cpu, pc + 2) << 8;
+	if (opcode == 0xcb)
+		decoded->cycles = _prefix_cycle_count(decoded->imm);
+}
+
+static inline void _execute_decoded(gb_cpu_t *cpu, const gb_decoded_t *decoded) {
+	cpu->pc += decoded->length;
+	cpu->imm = decoded->imm;
+	cpu->instruction_wait_cycles = decoded->cycles;
+	decoded->handler(cpu);
+}
+
+void execute_instruction(gb_cpu_t *cpu) {
+	gb_decoded_t decoded;
+	_decode(cpu, cpu->pc, &decoded);
+	_execute_decoded(cpu, &decoded);
+}
+
+/* block cache */
+
+/* identifies what is mapped at pc, blocks are only reused while the same bank is visible */
+uint16_t code_bank(gb_cpu_t *cpu, uint16_t pc) {
+	if (pc < 0x100 && cpu->boot_mapped)
+		return BOOT_ROM_BANK;
+	if (pc < 0x4000)
+		return cpu->cart->rom_bank[0];
+	if (pc < 0x8000)
+		return cpu->cart->rom_bank[1];
+	if (pc >= 0xa000 && pc < 0xc000)
+		return cpu->cart->ram_bank;
+	return 0;
+}
+
+/* where the region code_bank looked at for pc ends, a block can't run on into another bank */
+static uint32_t _code_bank_end(gb_cpu_t *cpu, uint16_t pc) {
+	if (pc < 0x100 && cpu->boot_mapped)
+		return 0x100;
+	if (pc < 0x4000)
+		return 0x4000;
+	if (pc < 0x8000)
+		return 0x8000;
+	if (pc < 0xa000)
+		return 0xa000;
+	if (pc < 0xc000)
+		return 0xc000;
+	return 0x10000;
+}
+
+static void _invalidate_code_line(gb_cpu_t *cpu, uint16_t line) {
+	uint32_t start = line << CODE_LINE_SHIFT;
+	uint32_t end = start + (1 << CODE_LINE_SHIFT);
+
+	for (int i = 0; i < BLOCK_CACHE_SIZE; i++) {
+		gb_block_t *block = &cpu->blocks[i];
+		if (block->valid && block->pc < end && block->end > start)
+			block->valid = 0;
 	}
+
+	cpu->code_lines[line] = 0;
+	cpu->block_invalidated = 1;
+	mmu_unprotect(cpu, line >> (MMU_PAGE_SHIFT - CODE_LINE_SHIFT));
+	if (cpu->jit)
+		jit_invalidate(cpu->jit);
 }
-static void _execute_instruction(gb_cpu_t *cpu, uint32_t instruction) {
-	register uint8_t n1 = (instruction & 0xf0000000) >> 28;
-	register uint8_t n2 = (instruction & 0x0f000000) >> 24;
-	
-	uint16_t immw = (instruction & 0x00ffff00) >> 8;
-	uint8_t imm1 = (instruction & 0x00ff0000) >> 16;
-	int8_t simm1 = (int8_t)imm1;
-	// https://www.pastraiser.com/cpu/gameboy/gameboy_opcodes.html
-
-	switch (n1) {
-		case 0x0: {
-			switch (n2) {
-				case 0x0: {
-					//nop
-					break;
-				}
-				case 0x1: {
-					//ld bc, d16
-					*cpu->bc = immw;
-					break;
-				}
-				case 0x2: {
-					*(cpu->addressSpace + *cpu->bc) = cpu->a;
-					break;
-				}
-				case 0x3: {
-					(*cpu->bc)++;
-					break;
-				}
-				case 0x4: {
-					cpu->b++;
-					break;
-				}
-				case 0x5: {
-					cpu->b--;
-					break;
-				}
-				case 0x6: {
-					cpu->b = imm1;
-					break;
-				}
-				case 0x7: {
-					//RLCA
-
-					set_flag(cpu, C, get_bit_on(cpu->a, 7));
-					set_flag(cpu, H, 0);
-					set_flag(cpu, N, 0);
-					cpu->a <<= 1;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x8: {
-					*(cpu->addressSpace + immw) = cpu->sp;
-					break;
-				}
-				case 0x9: {
-					*cpu->hl += *cpu->bc;
-					break;
-				}
-				case 0xA: {
-					cpu->a = *(cpu->addressSpace + *cpu->bc);
-					break;
-				}
-				case 0xB: {
-					(*cpu->bc)--;
-					break;
-				}
-				case 0xC: {
-					cpu->c++;
-					break;
-				}
-				case 0xD: {
-					cpu->c--;
-					break;
-				}
-				case 0xE: {
-					cpu->c = imm1;
-					break;
-				}
-				case 0xF: {
-					//RRCA
-					set_flag(cpu, C, get_bit_on(cpu->a, 0));
-					set_flag(cpu, H, 0);
-					set_flag(cpu, N, 0);
-					cpu->a >>= 1;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-			}
-			break;
-		}
-		case 0x1: {
-			switch (n2) {
-				case 0x0: {
-					_stop();
-					break;
-				}
-				case 0x1: {
-					*cpu->de = immw;
-					break;
-				}
-				case 0x2: {
-					*(cpu->addressSpace + *cpu->de) = cpu->a;
-					break;
-				}
-				case 0x3: {
-					(*cpu->de)++;
-					break;
-				}
-				case 0x4: {
-					cpu->d++;
-					break;
-				}
-				case 0x5: {
-					cpu->d--;
-					break;
-				}
-				case 0x6: {
-					cpu->d = imm1;
-					break;
-				}
-				case 0x7: {
-					set_flag(cpu, C, get_bit_on(cpu->a, 7));
-					set_flag(cpu, N, 0);
-					set_flag(cpu, H, 0);
-					cpu->a <<= 1;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x8: {
-					cpu->pc += simm1;
-					break;
-				}
-				case 0x9: {
-					*cpu->hl += *(cpu->de);
-					break;
-				}
-				case 0xA: {
-					cpu->a = *(cpu->addressSpace + *cpu->bc);
-					break;
-				}
-				case 0xB: {
-					(*cpu->bc)--;
-					break;
-				}
-				case 0xC: {
-					set_flag(cpu, N, 0);
-					set_flag(cpu, H, 0);
-					cpu->c++;
-					set_flag(cpu, Z, cpu->c == 0);
-					break;
-				}
-				case 0xD: {
-					set_flag(cpu, N, 1);
-					cpu->e--;
-					set_flag(cpu, Z, cpu->e == 0);
-					break;
-				}
-				case 0xE: {
-					cpu->e = imm1;
-					break;
-				}
-				case 0xF: {
-					set_flag(cpu, C, get_bit_on(cpu->a, 0));
-					set_flag(cpu, N, 0);
-					set_flag(cpu, H, 0);
-					cpu->a >>= get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-			}
+
+/* called by the mmu for writes to pages holding code, echo ram aliases work ram */
+void invalidate_code(gb_cpu_t *cpu, uint16_t address) {
+	uint16_t line = address >> CODE_LINE_SHIFT;
+	if (cpu->code_lines[line])
+		_invalidate_code_line(cpu, line);
+	if (address >= 0xc000 && address < 0xde00 && cpu->code_lines[line + (0x2000 >> CODE_LINE_SHIFT)])
+		_invalidate_code_line(cpu, line + (0x2000 >> CODE_LINE_SHIFT));
+	if (address >= 0xe000 && address < 0xfe00 && cpu->code_lines[line - (0x2000 >> CODE_LINE_SHIFT)])
+		_invalidate_code_line(cpu, line - (0x2000 >> CODE_LINE_SHIFT));
+}
+
+/* drops every block decoded from memory that can be rewritten, rom blocks are keyed by bank and stay */
+void flush_ram_code(gb_cpu_t *cpu) {
+	for (uint32_t line = 0x8000 >> CODE_LINE_SHIFT; line < (0x10000 >> CODE_LINE_SHIFT); line++) {
+		if (cpu->code_lines[line])
+			_invalidate_code_line(cpu, line);
+	}
+}
+
+void build_block(gb_cpu_t *cpu, gb_block_t *block, uint16_t pc) {
+	uint32_t address = pc;
+	uint32_t end = _code_bank_end(cpu, pc);
+
+	block->pc = pc;
+	block->bank = code_bank(cpu, pc);
+	block->cycles = 0;
+	block->count = 0;
+	block->pure = 1;
+	while (block->count < BLOCK_MAX_INSTRUCTIONS && address < end) {
+		gb_decoded_t *decoded = &block->instructions[block->count++];
+		uint8_t opcode = _read8(cpu, address);
+		_decode(cpu, address, decoded);
+		block->cycles += decoded->cycles;
+		if (!_instruction_is_pure[opcode] || (opcode == 0xcb && (decoded->imm & 7) == 6 && (decoded->imm & 0xc0) != 0x40))
+			block->pure = 0;
+		address += decoded->length;
+		if (_instruction_ends_block[opcode])
 			break;
-		}
-		case 0x2: {
-			switch (n2) {
-				case 0x0: {
-					if (!get_flag_on(cpu, Z)) {
-						cpu->pc += simm1;
-						cpu->instruction_wait_cycles = 12;
-					} else {
-						cpu->instruction_wait_cycles = 8;
-					}
+	}
+	block->end = address;
+	block->valid = 1;
+
+	if (address > 0x10000)
+		address = 0x10000;
+	for (uint32_t line = pc >> CODE_LINE_SHIFT; line <= (address - 1) >> CODE_LINE_SHIFT; line++) {
+		if (!cpu->code_lines[line])
+			mmu_protect(cpu, line >> (MMU_PAGE_SHIFT - CODE_LINE_SHIFT));
+		cpu->code_lines[line] = 1;
+	}
+}
 
-					break;
-				}
-				case 0x1: {
-					*(cpu->hl) = immw;
-					break;
-				}
-				case 0x2: {
-					*cpu->hl = cpu->a;
-					(*cpu->hl)++;
-					break;
-				}
-				case 0x3: {
-					(*cpu->hl)++;
-					break;
-				}
-				case 0x4: {
-					register uint16_t orig = cpu->h++;
+static inline void _fill_record(gb_cpu_t *cpu, gb_trace_record_t *record, uint8_t opcode, uint16_t imm) {
+	record->cycle = cpu->scheduler.now;
+	sync_flags(cpu);
+	memcpy(&record->af, &cpu->f, 12);
+	record->opcode[0] = opcode;
+	record->opcode[1] = imm;
+	record->opcode[2] = imm >> 8;
+	record->length = _instruction_byte_size[opcode];
+}
 
-					if ((get_bit_on(cpu->h, 4) ^ get_bit_on(orig, 4)) == 0)
-						set_flag(cpu, H, 1);
+static void _trace_instruction(gb_cpu_t *cpu) {
+	gb_trace_record_t record;
+	_fill_record(cpu, &record, _read8(cpu, cpu->pc), _read8(cpu, cpu->pc + 1) | _read8(cpu, cpu->pc + 2) << 8);
+	if (cpu->trace)
+		trace_write(cpu->trace, &record);
+	if (cpu->recorder)
+		*flight_record(cpu->recorder) = record;
+}
 
-					if (!cpu->h)
-						set_flag(cpu, Z, 1);
+static inline gb_block_t *_lookup_block(gb_cpu_t *cpu) {
+	uint16_t pc = cpu->pc;
+	uint16_t bank = code_bank(cpu, pc);
+	gb_block_t *block = &cpu->blocks[(pc ^ (pc >> 8) ^ bank) & (BLOCK_CACHE_SIZE - 1)];
 
-					set_flag(cpu, N, 0);
-					break;
-				}
-				case 0x5: {
-					register uint16_t orig = cpu->h--;
-					
-					if (get_bit_on(cpu->h, 4) ^ get_bit_on(orig, 4))
-						set_flag(cpu, H, 1);
+	if (!block->valid || block->pc != pc || block->bank != bank)
+		build_block(cpu, block, pc);
+	return block;
+}
 
-					if (!cpu->h)
-						set_flag(cpu, Z, 1);
+/*
+ * runs the cached block at pc, stopping early at limit or when a write invalidated code.
+ * a pure block that loops back on itself without changing any register is polling memory
+ * that nothing else touches before limit, so its remaining iterations are skipped in one go
+ */
+static inline void _execute_block(gb_cpu_t *cpu, uint64_t limit) {
+	gb_scheduler_t *scheduler = &cpu->scheduler;
+	gb_block_t *block = _lookup_block(cpu);
+	bool whole = scheduler->now + block->cycles < limit;
+	uint64_t start = scheduler->now;
+	uint8_t registers[12];
+	gb_flags_t flags;
+	int i;
+
+	// only block entries are recorded, everything up to the next entry is the block's straight line code
+	if (cpu->recorder)
+		_fill_record(cpu, flight_record(cpu->recorder), block->instructions[0].opcode, block->instructions[0].imm);
+
+	if (block->pure) {
+		memcpy(registers, &cpu->f, sizeof(registers));
+		flags = cpu->flags;
+	}
 
-					set_flag(cpu, N, 1);
-					break;
-				}
-				case 0x6: {
-					cpu->h = imm1;
-					break;
-				}
-				case 0x7: {
-					if (!cpu->a)
-						set_flag(cpu, Z, 1);
-
-					register bool needed = 0;
-					if ((cpu->a & 0xf) > 0x9 || get_flag_on(cpu, H)) {
-						cpu->a += 0x6;
-						needed = 1;
-					}
-
-					if ((cpu->a & 0xf0) >> 0xf > 0x9 || get_flag_on(cpu, C)) {
-						cpu->a += 0x60;
-						needed = 1;
-					}
-
-					set_flag(cpu, C, needed);
-					set_flag(cpu, H, 0);
-					break;
-				}
-				case 0x8: {
-					if (get_flag_on(cpu, Z)) {
-						cpu->pc += simm1;
-						cpu->instruction_wait_cycles = 12;
-					} else {
-						cpu->instruction_wait_cycles = 8;
-					}
-						
-					break;
-				}
-				case 0x9: {
-					register uint32_t add = *(cpu->hl) * 2;
-					*(cpu->hl) *= 2;
-					
-					if (get_bit_on(add, 16))
-						set_flag(cpu, C, 1);
+	cpu->block_invalidated = 0;
+	for (i = 0; i < block->count; i++) {
+		_execute_decoded(cpu, &block->instructions[i]);
+		scheduler->now += cpu->instruction_wait_cycles ? cpu->instruction_wait_cycles : 4;
+		if (cpu->block_invalidated || (!whole && scheduler->now >= limit))
+			break;
+	}
 
-					if (get_bit_on(add, 4) & get_bit_on(*(cpu->hl), 4))
-						set_flag(cpu, H, 1);
+	if (block->pure && i == block->count && cpu->pc == block->pc && scheduler->now < limit &&
+		!memcmp(registers, &cpu->f, sizeof(registers)) && !memcmp(&flags, &cpu->flags, sizeof(flags))) {
+		uint64_t period = scheduler->now - start;
+		scheduler->now += (limit - scheduler->now - 1) / period * period;
+	}
+}
 
-					set_flag(cpu, N, 0);
-					break;
-				}
-				case 0xA: {
-					cpu->a = *cpu->hl;
-					(*cpu->hl)++;
-					break;
-				}
-				case 0xB: {
-					(*cpu->hl)--;
-					break;
-				}
-				case 0xC: {
-					register uint16_t orig = cpu->l++;
+bool add_watchpoint(gb_cpu_t *cpu, uint16_t address) {
+	if (cpu->watchpoint_count == MAX_WATCHPOINTS)
+		return 0;
+	cpu->watchpoints[cpu->watchpoint_count++] = address;
+	mmu_watch(cpu, address >> MMU_PAGE_SHIFT);
+	return 1;
+}
 
-					if ((get_bit_on(cpu->l, 4) ^ get_bit_on(orig, 4)) == 0)
-						set_flag(cpu, H, 1);
+/* writes to a watched page leave the fast path, this picks out the watched addresses */
+void check_watchpoints(gb_cpu_t *cpu, uint16_t address) {
+	for (int i = 0; i < cpu->watchpoint_count; i++) {
+		if (cpu->watchpoints[i] != address)
+			continue;
+		fprintf(stderr, "Watchpoint 0x%04x written at pc 0x%04x.\n", address, cpu->pc);
+		if (cpu->recorder)
+			flight_dump(cpu->recorder, "watchpoint");
+	}
+}
 
-					if (!cpu->l)
-						set_flag(cpu, Z, 1);
+void request_interrupts(gb_cpu_t *cpu, uint8_t interrupts) {
+	cpu->addressSpace[0xff0f] |= interrupts;
+}
 
-					set_flag(cpu, N, 0);
-					break;
-				}
-				case 0xD: {
-					register uint16_t orig = cpu->l--;
+/* passes on any overflow the timer caught up on and schedules its next one */
+void update_timer(gb_cpu_t *cpu) {
+	if (cpu->timer.interrupts) {
+		request_interrupts(cpu, cpu->timer.interrupts);
+		cpu->timer.interrupts = 0;
+	}
+	schedule_event(&cpu->scheduler, GB_EVENT_TIMER, timer_overflow(&cpu->timer));
+}
 
-					if (get_bit_on(cpu->l, 4) ^ get_bit_on(orig, 4))
-						set_flag(cpu, H, 1);
+/* called between frames with the buttons held for the next one */
+void set_buttons(gb_cpu_t *cpu, uint8_t buttons) {
+	joypad_set(&cpu->joypad, buttons);
+	if (cpu->joypad.interrupts) {
+		request_interrupts(cpu, cpu->joypad.interrupts);
+		cpu->joypad.interrupts = 0;
+	}
+}
 
-					if (!cpu->l)
-						set_flag(cpu, Z, 1);
+/* jumps to the vector of the highest priority interrupt that is both requested and enabled */
+static void _dispatch_interrupt(gb_cpu_t *cpu, uint8_t pending) {
+	int bit = __builtin_ctz(pending);
+	cpu->addressSpace[0xff0f] &= ~(1 << bit);
+	cpu->interrupts = 0;
+	cpu->halt = 0;
+	_push16(cpu, cpu->pc);
+	cpu->pc = 0x40 + bit * 8;
+	cpu->scheduler.now += 20;
+}
 
-					set_flag(cpu, N, 0);
-					break;
-				}
-				case 0xE: {
-					cpu->l = imm1;
-					break;
-				}
-				case 0xF: {
-					cpu->a = ~cpu->a;
-					set_flag(cpu, N, 1);
-					set_flag(cpu, H, 1);
-					break;
-				}
+static void _step_instruction(gb_cpu_t *cpu) {
+	if (cpu->trace || cpu->recorder)
+		_trace_instruction(cpu);
+	execute_instruction(cpu);
+
+	// illegal opcodes have no cycle count, they lock up in place instead of stalling time
+	cpu->scheduler.now += cpu->instruction_wait_cycles ? cpu->instruction_wait_cycles : 4;
+}
+
+static void _handle_event(gb_cpu_t *cpu, gb_event_t event) {
+	gb_scheduler_t *scheduler = &cpu->scheduler;
+	switch (event) {
+		case GB_EVENT_PPU: {
+			// by due time, not by when it runs, so a step handled late past a frame's end still counts
+			cpu->ppu->skip_render = scheduler->when[GB_EVENT_PPU] < cpu->render_from;
+			schedule_event(scheduler, GB_EVENT_PPU, scheduler->when[GB_EVENT_PPU] + ppu_step(cpu->ppu));
+			if (cpu->ppu->interrupts) {
+				request_interrupts(cpu, cpu->ppu->interrupts);
+				cpu->ppu->interrupts = 0;
 			}
 			break;
 		}
-		case 0x3: {
-			switch (n2) {
-				case 0x0: {
-					if (!get_flag_on(cpu, C)) {
-						cpu->pc += simm1;
-						cpu->instruction_wait_cycles = 12;
-					} else {
-						cpu->instruction_wait_cycles = 8;
-					}
-
-					break;
-				}
-				case 0x1: {
-					cpu->sp = immw;
-					break;
-				}
-				case 0x2: {
-					*cpu->hl = cpu->a;
-					(*cpu->hl)--;
-					break;
-				}
-				case 0x3: {
-					cpu->sp++;
-					break;
-				}
-				case 0x4: {
-					(*cpu->hl)++;
-					break;
-				}
-				case 0x5: {
-					(*cpu->hl)--;
-					break;
-				}
-				case 0x6: {
-					(*cpu->hl) = imm1;
-					break;
-				}
-				case 0x7: {
-					set_flag(cpu, C, 1);
-					set_flag(cpu, N, 0);
-					set_flag(cpu, H, 0);
-					break;
-				}
-				case 0x8: {
-					if (get_flag_on(cpu, C)) {
-						cpu->pc += simm1;
-						cpu->instruction_wait_cycles = 12;
-					} else {
-						cpu->instruction_wait_cycles = 8;
-					}
-						
-					break;
-				}
-				case 0x9: {
-					(*cpu->hl) += sp;
-					break;
-				}
-				case 0xA: {
-					cpu->a = *cpu->hl;
-					(*cpu->hl)--;
-					break;
-				}
-				case 0xB: {
-					cpu->sp--;
-					break;
-				}
-				case 0xC: {
-					cpu->a++;
-					break;
-				}
-				case 0xD: {
-					if (--cpu->a & 0xf == 0xf)
-						set_flag(cpu, H, 1);
-
-					set_flag(cpu, N, 1);
-					set_flag(cpu, Z, !cpu->a);
-					break;
-				}
-				case 0xE: {
-					cpu->a = imm1;
-					break;
-				}
-				case 0xF: {
-					set_flag(cpu, C, ~get_flag_on(cpu, C));
-					set_flag(cpu, N, 0);
-					set_flag(cpu, H, 0);
-					break;
-				}
-			}
-			break;
-		}
-		case 0x4: {
-			switch (n2) {
-				case 0x0: {
-					cpu->b = cpu->b;
-					break;
-				}
-				case 0x1: {
-					cpu->b = cpu->c;
-					break;
-				}
-				case 0x2: {
-					cpu->b = cpu->d;
-					break;
-				}
-				case 0x3: {
-					cpu->b = cpu->e;
-					break;
-				}
-				case 0x4: {
-					cpu->b = cpu->h;
-					break;
-				}
-				case 0x5: {
-					cpu->b = cpu->l;
-					break;
-				}
-				case 0x6: {
-					cpu->b = cpu->addressSpace[*(cpu->hl)];
-					break;
-				}
-				case 0x7: {
-					cpu->b = cpu->a;
-					break;
-				}
-				case 0x8: {
-					cpu->c = cpu->b;
-					break;
-				}
-				case 0x9: {
-					cpu->c = cpu->c;
-					break;
-				}
-				case 0xA: {
-					cpu->c = cpu->d;
-					break;
-				}
-				case 0xB: {
-					cpu->c = cpu->e;
-					break;
-				}
-				case 0xC: {
-					cpu->c = cpu->h;
-					break;
-				}
-				case 0xD: {
-					cpu->c = cpu->l;
-					break;
-				}
-				case 0xE: {
-					cpu->c = cpu->addressSpace[*(cpu->hl)];
-					break;
-				}
-				case 0xF: {
-					cpu->c = cpu->a;
-					break;
-				}
-			}
-			break;
-		}
-		case 0x5: {
-			switch (n2) {
-				case 0x0: {
-					cpu->d = cpu->b;
-					break;
-				}
-				case 0x1: {
-					cpu->d = cpu->c;
-					break;
-				}
-				case 0x2: {
-					cpu->d = cpu->d;
-					break;
-				}
-				case 0x3: {
-					cpu->d = cpu->e;
-					break;
-				}
-				case 0x4: {
-					cpu->d = cpu->h;
-					break;
-				}
-				case 0x5: {
-					cpu->d = cpu->l;
-					break;
-				}
-				case 0x6: {
-					cpu->d = cpu->addressSpace[*(cpu->hl)];
-					break;
-				}
-				case 0x7: {
-					cpu->d = cpu->a;
-					break;
-				}
-				case 0x8: {
-					cpu->e = cpu->b;
-					break;
-				}
-				case 0x9: {
-					cpu->e = cpu->c;
-					break;
-				}
-				case 0xA: {
-					cpu->e = cpu->d;
-					break;
-				}
-				case 0xB: {
-					cpu->e = cpu->e;
-					break;
-				}
-				case 0xC: {
-					cpu->e = cpu->h;
-					break;
-				}
-				case 0xD: {
-					cpu->e = cpu->l;
-					break;
-				}
-				case 0xE: {
-					cpu->e = cpu->addressSpace[*(cpu->hl)];
-					break;
-				}
-				case 0xF: {
-					cpu->e = cpu->a;
-					break;
-				}
-			}
-			break;
-		}
-		case 0x6: {
-			switch (n2) {
-				case 0x0: {
-					cpu->h = cpu->b;
-					break;
-				}
-				case 0x1: {
-					cpu->h = cpu->c;
-					break;
-				}
-				case 0x2: {
-					cpu->h = cpu->d;
-					break;
-				}
-				case 0x3: {
-					cpu->h = cpu->e;
-					break;
-				}
-				case 0x4: {
-					cpu->h = cpu->h;
-					break;
-				}
-				case 0x5: {
-					cpu->h = cpu->l;
-					break;
-				}
-				case 0x6: {
-					cpu->h = cpu->addressSpace[*(cpu->hl)];
-					break;
-				}
-				case 0x7: {
-					cpu->h = cpu->a;
-					break;
-				}
-				case 0x8: {
-					cpu->l = cpu->b;
-					break;
-				}
-				case 0x9: {
-					cpu->l = cpu->c;
-					break;
-				}
-				case 0xA: {
-					cpu->l = cpu->d;
-					break;
-				}
-				case 0xB: {
-					cpu->l = cpu->e;
-					break;
-				}
-				case 0xC: {
-					cpu->l = cpu->h;
-					break;
-				}
-				case 0xD: {
-					cpu->l = cpu->l;
-					break;
-				}
-				case 0xE: {
-					cpu->l = cpu->addressSpace[*(cpu->hl)];
-					break;
-				}
-				case 0xF: {
-					cpu->l = cpu->a;
-					break;
-				}
-			}
-			break;
-		}
-		case 0x7: {
-			switch (n2) {
-				case 0x0: {
-					cpu->addressSpace[*(cpu->hl)] = cpu->b;
-					break;
-				}
-				case 0x1: {
-					cpu->addressSpace[*(cpu->hl)] = cpu->c;
-					break;
-				}
-				case 0x2: {
-					cpu->addressSpace[*(cpu->hl)] = cpu->d;
-					break;
-				}
-				case 0x3: {
-					cpu->addressSpace[*(cpu->hl)] = cpu->e;
-					break;
-				}
-				case 0x4: {
-					cpu->addressSpace[*(cpu->hl)] = cpu->h;
-					break;
-				}
-				case 0x5: {
-					cpu->addressSpace[*(cpu->hl)] = cpu->l;
-					break;
-				}
-				case 0x6: {
-					// halt
-					break;
-				}
-				case 0x7: {
-					cpu->addressSpace[*(cpu->hl)] = cpu->a;
-					break;
-				}
-				case 0x8: {
-					cpu->a = cpu->b;
-					break;
-				}
-				case 0x9: {
-					cpu->a = cpu->c;
-					break;
-				}
-				case 0xA: {
-					cpu->a = cpu->d;
-					break;
-				}
-				case 0xB: {
-					cpu->a = cpu->e;
-					break;
-				}
-				case 0xC: {
-					cpu->a = cpu->h;
-					break;
-				}
-				case 0xD: {
-					cpu->a = cpu->l;
-					break;
-				}
-				case 0xE: {
-					cpu->a = cpu->addressSpace[*(cpu->hl)];
-					break;
-				}
-				case 0xF: {
-					cpu->a = cpu->a;
-					break;
-				}
-			}
-			break;
-		}
-		case 0x8: {
-			switch (n2) {
-				case 0x0: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->b;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x1: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->c;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x2: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->d;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x3: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->e;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x4: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->h;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x5: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->l;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x6: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += *(cpu->addressSpace + *cpu->hl);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x7: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->a;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-
-				}
-				case 0x8: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->b + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x9: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->c + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0xA: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->d + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0xB: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->e + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0xC: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->h + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0xD: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->l + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0xE: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += *(cpu->addressSpace + *cpu->hl) + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0xF: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a += cpu->a + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-			}
-
-			//set_flag(cpu, N, 0);			
-			break;
-		}
-		case 0x9: {
-			switch (n2) {
-				case 0x0: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->b;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x1: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->c;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x2: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->d;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x3: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->e;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x4: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->h;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x5: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->l;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x6: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= *(cpu->addressSpace + *cpu->hl);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x7: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->a;
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-
-				}
-				case 0x8: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->b + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0x9: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->c + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0xA: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->d + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0xB: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->e + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0xC: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->h + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0xD: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->l + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0xE: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= *(cpu->addressSpace + *cpu->hl) + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-				case 0xF: {
-					set_flag(cpu, N, 0);
-					//todo: set c and h
-					cpu->a -= cpu->a + get_flag_on(cpu, C);
-					set_flag(cpu, Z, cpu->a == 0);
-					break;
-				}
-			}
-
-			set_flag(cpu, N, 1);
+		case GB_EVENT_TIMER: {
+			timer_sync(&cpu->timer, scheduler->now);
+			update_timer(cpu);
 			break;
 		}
-		case 0xA: {
-			set_flag(cpu, N, 0);
-			set_flag(cpu, C, 0);
-			if (n2 < 0x8) {
-				uint8_t *reg = n2 == 0x6 ? cpu->addressSpace + *(cpu->hl) : cpu->registers[n2];
-				set_flag(cpu, H, 1);
-				cpu->a = (cpu->a && *reg);
-			} else {
-				uint8_t *reg = n2 == 0xE ? cpu->addressSpace + *(cpu->hl) : cpu->registers[n2 - 8];
-				set_flag(cpu, H, 0);
-				cpu->a = (!cpu->a != !*reg);
-			}
-			
-			set_flag(cpu, Z, cpu->a == 0);
+		case GB_EVENT_RTC: {
+			cart_tick_rtc(cpu->cart);
+			schedule_event(scheduler, GB_EVENT_RTC, scheduler->when[GB_EVENT_RTC] + CYCLES_PER_SECOND);
 			break;
 		}
-		case 0xB: {
-			if (n2 < 0x8) {
-				uint8_t *reg = n2 == 0x6 ? cpu->addressSpace + *(cpu->hl) : cpu->registers[n2];
-				
-				set_flag(cpu, N, 0);
-				set_flag(cpu, H, 0);
-				set_flag(cpu, C, 0);
-				
-				cpu->a = (cpu->a || *reg);
-				set_flag(cpu, Z, cpu->a == 0);
-			} else {
-				uint8_t *reg = n2 == 0xE ? cpu->addressSpace + *(cpu->hl) : cpu->registers[n2 - 8];
-
-				if (cpu->a == *reg)
-					set_flag(cpu, Z, 1);
-
-				if (cpu-> a & 0xf < *reg & 0xf)
-					set_flag(cpu, H, 1);
-
-				if (cpu->a < *reg)
-					set_flag(cpu, C, 1);
-
-				set_flag(cpu, N, 1);
-			}
+		default:
 			break;
-		}
-		case 0xC: {
-			switch (n2) {
-				case 0x0: {
-					if (!get_flag_on(cpu, Z)) {
-						cpu->pc = (cpu->addressSpace[cpu->sp] << 8) | cpu->addressSpace[cpu->sp + 1];
-						cpu->sp += 2;
-						cpu->instruction_wait_cycles = 20;
-					} else {
-						cpu->instruction_wait_cycles = 8;
-					}
-
-					break;
-				}
-				case 0x1: {
-					cpu->b = cpu->addressSpace[cpu->sp];
-					cpu->c = cpu->addressSpace[cpu->sp + 1];
-					cpu->sp += 2;
-					break;
-				}
-				case 0x2: {
-					if (!get_flag_on(cpu, Z)) {
-						cpu->pc = immw;
-						cpu->instruction_wait_cycles = 16;
-					} else {
-						cpu->instruction_wait_cycles = 12;
-					}
-						
-					break;
-				}
-				case 0x3: {
-					cpu->pc = immw;
-					break;
-				}
-				case 0x4: {
-					if (!get_flag_on(cpu, Z)) {
-						cpu->sp -= 2;
-						cpu->addressSpace[cpu->sp] = (cpu->pc & 0xff00) >> 8;
-						cpu->addressSpace[cpu->sp + 1] = cpu->pc & 0xff;
-
-						cpu->pc = immw;
-						cpu->instruction_wait_cycles = 24;
-					} else {
-						cpu->instruction_wait_cycles = 12;
-					}
-					 
-
-					break;
-				}
-				case 0x5: {
-					cpu->sp -= 2;
-					cpu->addressSpace[cpu->sp] = cpu->b;
-					cpu->addressSpace[cpu->sp + 1] = cpu->c;
-					break;
-				}
-				case 0x6: {
-					// add a, d8
-					break;
-				}
-				case 0x7: {
-					cpu->sp -= 2;
-					cpu->addressSpace[cpu->sp] = (cpu->pc & 0xff00) >> 4;
-					cpu->addressSpace[cpu->sp + 1] = cpu->pc & 0xff;
-
-					cpu->pc = 0;
-					break;
-				}
-				case 0x8: {
-					if (get_flag_on(cpu, Z)) {
-						uint16_t jmpAddress = cpu->addressSpace[cpu->sp];
-						jmpAddress <<= 8;
-						jmpAddress |= cpu->addressSpace[cpu->sp + 1];
-						cpu->sp += 2;
-						cpu->pc = jmpAddress;
-						cpu->instruction_wait_cycles = 20;
-					} else {
-						cpu->instruction_wait_cycles = 8;
-					}
-					break;
-				}
-				case 0x9: {
-					uint16_t jmpAddress = cpu->addressSpace[cpu->sp];
-					jmpAddress <<= 8;
-					jmpAddress |= cpu->addressSpace[cpu->sp + 1];
-					cpu->sp += 2;
-					cpu->pc = jmpAddress;
-					break;
-				}
-				case 0xA: {
-					if (get_flag_on(cpu, C)) {
-						cpu->pc = imm1;
-						cpu->instruction_wait_cycles = 16;
-					} else {
-						cpu->instruction_wait_cycles = 12;
-					}
-						
-					break;
-				}
-				case 0xB: {
-					// cb, should never get here
-					break;
-				}
-				case 0xC: {
-					if (get_flag_on(cpu, Z)) {
-						cpu->sp -= 2;
-						cpu->addressSpace[cpu->sp] = (cpu->pc & 0xff00) >> 8;
-						cpu->addressSpace[cpu->sp + 1] = cpu->pc & 0xff;
-
-						cpu->pc = immw;
-						cpu->instruction_wait_cycles = 24;
-					} else {
-						cpu->instruction_wait_cycles = 12;
-					}
-
-					break;
-				}
-				case 0xD: {
-					cpu->sp -= 2;
-					cpu->addressSpace[cpu->sp] = (cpu->pc & 0xff00) >> 8;
-					cpu->addressSpace[cpu->sp + 1] = cpu->pc & 0xff;
-
-					cpu->pc = immw;
-					break;
-				}
-				case 0xE: {
-					// adc a, d8
-					break;
-				}
-				case 0xF: {
-					cpu->sp -= 2;
-					cpu->addressSpace[cpu->sp] = (cpu->pc & 0xff00) >> 8;
-					cpu->addressSpace[cpu->sp + 1] = cpu->pc & 0xff;
-
-					cpu->pc = 0x8;
-					break;
-				}
-			}
-			break;
-		}
-		case 0xD: {
-			switch (n2) {
-				case 0x0: {
-					if (!get_flag_on(cpu, C)) {
-						cpu->pc = (cpu->addressSpace[cpu->sp] << 8) | cpu->addressSpace[cpu->sp + 1];
-						cpu->sp += 2;
-						cpu->instruction_wait_cycles = 20;
-					} else {
-						cpu->instruction_wait_cycles = 8;
-					}
-					break;
-				}
-				case 0x1: {
-					cpu->d = cpu->addressSpace[cpu->sp];
-					cpu->e = cpu->addressSpace[cpu->sp + 1];
-					cpu->sp += 2;
-					break;
-				}
-				case 0x2: {
-					if (!get_flag_on(cpu, C)) {
-						cpu->pc = imm1;
-						cpu->instruction_wait_cycles = 16;
-					} else {
-						cpu->instruction_wait_cycles = 12;
-					}
-
-					break;
-				}
-				case 0x3: {
-					// nothing
-					break;
-				}
-				case 0x4: {
-					if (!get_flag_on(cpu, C)) {
-						cpu->sp -= 2;
-						cpu->addressSpace[cpu->sp] = (cpu->pc & 0xff00) >> 8;
-						cpu->addressSpace[cpu->sp + 1] = cpu->pc & 0xff;
-
-						cpu->pc = immw;
-						cpu->instruction_wait_cycles = 24;
-					} else {
-						cpu->instruction_wait_cycles = 12;
-					}
-					break;
-				}
-				case 0x5: {
-					cpu->sp -= 2;
-					cpu->addressSpace[cpu->sp] = cpu->d;
-					cpu->addressSpace[cpu->sp + 1] = cpu->e;
-					break;
-				}
-				case 0x6: {
-					// sub d8
-					break;
-				}
-				case 0x7: {
-					cpu->sp -= 2;
-					cpu->addressSpace[cpu->sp] = (cpu->pc & 0xff00) >> 8;
-					cpu->addressSpace[cpu->sp + 1] = cpu->pc & 0xff;
-
-					cpu->pc = 0x10;
-					break;
-				}
-				case 0x8: {
-					if (get_flag_on(cpu, C)) {
-						cpu->pc = (cpu->addressSpace[cpu->sp] << 8) | cpu->addressSpace[cpu->sp + 1];
-						cpu->sp += 2;
-						cpu->instruction_wait_cycles = 20;
-					} else {
-						cpu->instruction_wait_cycles = 8;
-					}
-
-					break;
-				}
-				case 0x9: {
-					cpu->pc = (cpu->addressSpace[cpu->sp] << 8) | cpu->addressSpace[cpu->sp + 1];
-					cpu->sp += 2;
-
-					cpu->interrupts = 1;
-					break;
-				}
-				case 0xA: {
-					if (get_flag_on(cpu, C)) {
-						cpu->pc = imm1;
-						cpu->instruction_wait_cycles = 16;
-					} else {
-						cpu->instruction_wait_cycles = 12;
-					}
-					break;
-				}
-				case 0xB: {
-					// nothing
-					break;
-				}
-				case 0xC: {
-					if (get_flag_on(cpu, C)) {
-						cpu->sp -= 2;
-						cpu->addressSpace[cpu->sp] = (cpu->pc & 0xff00) >> 8;
-						cpu->addressSpace[cpu->sp + 1] = cpu->pc & 0xff;
-
-						cpu->pc = immw;
-						cpu->instruction_wait_cycles = 24;
-					} else {
-						cpu->instruction_wait_cycles = 12;
-					}
-
-					break;
-				}
-				case 0xD: {
-					// nothing
-					break;
-				}
-				case 0xE: {
-					// adc a, d8
-					break;
-				}
-				case 0xF: {
-					cpu->sp -= 2;
-					cpu->addressSpace[cpu->sp] = (cpu->pc & 0xff00) >> 8;
-					cpu->addressSpace[cpu->sp + 1] = cpu->pc & 0xff;
+	}
+}
 
-					cpu->pc = 0x18;
-					break;
-				}
+void run_until(gb_cpu_t *cpu, uint64_t target) {
+	gb_scheduler_t *scheduler = &cpu->scheduler;
+
+	/* execute whole instructions up to the next due event instead of counting down every cycle */
+	while (scheduler->now < target) {
+		uint64_t limit = scheduler->next < target ? scheduler->next : target;
+		while (scheduler->now < limit) {
+			uint8_t pending = cpu->addressSpace[0xff0f] & cpu->addressSpace[0xffff] & 0x1f;
+			if (pending && cpu->interrupts) {
+				_dispatch_interrupt(cpu, pending);
+				continue;
 			}
-			break;
-		}
-		case 0xE: {
-			switch (n2) {
-				case 0x0: {
-					cpu->a = cpu->addressSpace[0xFF00 + imm1];
-					break;
-				}
-				case 0x1: {
-					cpu->h = cpu->addressSpace[cpu->sp];
-					cpu->l = cpu->addressSpace[cpu->sp + 1];
-					cpu->sp += 2;
-					break;
-				}
-				case 0x2: {
-					cpu->a = cpu->addressSpace[cpu->c];
-					break;
-				}
-				case 0x3: {
-					// nothing
-					break;
-				}
-				case 0x4: {
-					// nothing
-					break;
-				}
-				case 0x5: {
-					cpu->sp -= 2;
-					cpu->addressSpace[cpu->sp] = cpu->h;
-					cpu->addressSpace[cpu->sp + 1] = cpu->l;
-					break;
-				}
-				case 0x6: {
-					// and d8
-					break;
-				}
-				case 0x7: {
-					cpu->sp -= 2;
-					cpu->addressSpace[cpu->sp] = (cpu->pc & 0xff00) >> 8;
-					cpu->addressSpace[cpu->sp + 1] = cpu->pc & 0xff;
-
-					cpu->pc = 0x20;
-					break;
-				}
-				case 0x8: {
-					// add sp, r8
-					break;
-				}
-				case 0x9: {
-					cpu->pc = cpu->addressSpace[*(cpu->hl)];
-					break;
-				}
-				case 0xA: {
-					cpu->addressSpace[immw] = cpu->a;
-					break;
-				}
-				case 0xB: {
-					// nothing
-					break;
-				}
-				case 0xC: {
-					// nothing
-					break;
-				}
-				case 0xD: {
-					// nothing
-					break;
-				}
-				case 0xE: {
-					// xor d8
-					break;
-				}
-				case 0xF: {
-					cpu->sp -= 2;
-					cpu->addressSpace[cpu->sp] = (cpu->pc & 0xff00) >> 8;
-					cpu->addressSpace[cpu->sp + 1] = cpu->pc & 0xff;
-
-					cpu->pc = 0x28;
+			// a halted cpu sleeps through to the next event unless an enabled interrupt is already waiting
+			if (cpu->halt) {
+				if (!pending) {
+					scheduler->now += (limit - scheduler->now + 3) & ~3;
 					break;
 				}
+				cpu->halt = 0;
 			}
-			break;
-		}
-		case 0xF: {
-			switch (n2) {
-				case 0x0: {
-					cpu->a = cpu->addressSpace[0xff00 + imm1];
-					break;
-				}
-				case 0x1: {
-					cpu->a = cpu->addressSpace[cpu->sp];
-					cpu->f = cpu->addressSpace[cpu->sp + 1];
-					cpu->sp += 2;
-					break;
-				}
-				case 0x2: {
-					cpu->addressSpace[cpu->c] = cpu->a;
-					break;
-				}
-				case 0x3: {
-					cpu->interrupts = 0;
-					break;
-				}
-				case 0x4: {
-					// nothing
-					break;
-				}
-				case 0x5: {
-					cpu->sp -= 2;
-					cpu->addressSpace[cpu->sp] = cpu->a;
-					cpu->addressSpace[cpu->sp + 1] = cpu->f;
-					break;
-				}
-				case 0x6: {
-					// or d8
-					break;
-				}
-				case 0x7: {
-					cpu->sp -= 2;
-					cpu->addressSpace[cpu->sp] = (cpu->pc & 0xff00) >> 8;
-					cpu->addressSpace[cpu->sp + 1] = cpu->pc & 0xff;
-
-					cpu->pc = 0x30;
-					break;
-				}
-				case 0x8: {
-					// ld hl, sp + r8
-					break;
-				}
-				case 0x9: {
-					cpu->sp = *(cpu->hl);
-					break;
-				}
-				case 0xA: {
-					cpu->a = cpu->addressSpace[immw];
-					break;
-				}
-				case 0xB: {
+			// ei always ends a block, so the one instruction it lets through runs on its own
+			if (cpu->ei_delay) {
+				_step_instruction(cpu);
+				if (cpu->ei_delay) {
+					cpu->ei_delay = 0;
 					cpu->interrupts = 1;
-					break;
-				}
-				case 0xC: {
-					// nothing
-					break;
-				}
-				case 0xD: {
-					// nothing
-					break;
-				}
-				case 0xE: {
-					// cp d8
-					break;
-				}
-				case 0xF: {
-					cpu->sp -= 2;
-					cpu->addressSpace[cpu->sp] = (cpu->pc & 0xff00) >> 8;
-					cpu->addressSpace[cpu->sp + 1] = cpu->pc & 0xff;
-
-					cpu->pc = 0x38;
-					break;
 				}
+				continue;
 			}
-			break;
-		}
-	}
-
-}
-
-static void _execute_prefix_instruction(gb_cpu_t *cpu, uint8_t opcode) {
-	register uint8_t n1 = (opcode & 0xf0) >> 4;
-	register uint8_t n2 = opcode & 0x0f;
-	register uint8_t *reg = cpu->registers[(n2 % 8)];
-	if (n2 % 8 == 6) {
-		reg = cpu->addressSpace + *(cpu->hl);
-		cpu->instruction_wait_cycles = 16;
-	} else {
-		cpu->instruction_wait_cycles = 8;
-	}
-
-	switch (n1) {
-		case 0x0: {
-			set_flag(cpu, N, 0);
-			set_flag(cpu, H, 0);
-
-			if (n2 < 0x8) {
-				bool bit = get_bit_on(*reg, 7);
-				set_flag(cpu, C, bit);
-				*reg = (*reg << 1) | bit;
-			} else {
-				bool bit = get_bit_on(*reg, 0);
-				set_flag(cpu, C, bit);
-				*reg = (*reg >> 1) | (bit << 7);
-			}
-			
-			set_flag(cpu, Z, *reg == 0);
-			break;
-		}
-		case 0x1: {
-			set_flag(cpu, N, 0);
-			set_flag(cpu, H, 0);
-			if (n2 < 0x8) {
-				bool bit = get_flag_on(cpu, C);
-				set_flag(cpu, C, get_bit_on(*reg, 7));
-				*reg = ((*reg) << 1) | bit;
-			} else {
-				bool bit = get_bit_on(*reg, 0);
-				*reg = ((*reg) >> 1) | (get_flag_on(cpu, C) << 7);
-				set_flag(cpu, C, bit);
+			if (cpu->jit && jit_execute(cpu->jit, limit))
+				continue;
+			if (!cpu->trace) {
+				_execute_block(cpu, limit);
+				continue;
 			}
-
-			set_flag(cpu, Z, (*reg) == 0);
-			break;
-		}
-		case 0x2: {
-			set_flag(cpu, N, 0);
-			set_flag(cpu, H, 0);
-			if (n2 < 0x8) {
-				set_flag(cpu, C, get_bit_on(*reg, 7));
-				*reg <<= 1;
-				set_bit_on(*reg, 0, 0);
-			} else {
-				bool bit = get_bit_on(*reg, 7);
-				set_flag(cpu, C, get_bit_on(*reg, 0));
-				*reg >>= 1;
-				set_bit_on(*reg, 7, bit);
-			}
-			set_flag(cpu, Z, *reg == 0);
-			break;
-		}
-		case 0x3: {
-			set_flag(cpu, N, 0);
-			set_flag(cpu, H, 0);
-			if (n2 < 0x8) {
-				set_flag(cpu, C, 0);
-				uint8_t newValue = ((*reg << 4) & 0xf0) | ((*reg >> 4) & 0x0f);
-				*reg = newValue;
-			} else {
-				bool bit = get_bit_on(*reg, 0);
-				set_flag(cpu, C, bit);
-				*reg >>= 1;
-				set_bit_on(*reg, 7, 0);
-			}
-			set_flag(cpu, Z, *reg == 0);
-			break;
-		}
-		case 0x4:
-		case 0x5:
-		case 0x6:
-		case 0x7: {
-			uint8_t bit = n2 < 0x8 ? (n1 - 0x4) * 2 : (n1 - 0x4) * 2 + 1;
-			bool status = get_bit_on(*reg, bit);
-			set_flag(cpu, N, 0);
-			set_flag(cpu, H, 1);
-			set_flag(cpu, Z, !status);
-			break;
-		}
-		
-		case 0x8:
-		case 0x9:
-		case 0xA:
-		case 0xB: {
-			uint8_t bit = n2 < 0x8 ? (n1 - 0x4) * 2 : (n1 - 0x4) * 2 + 1;
-			set_bit_on(*reg, bit, 0);
-			break;
+			_step_instruction(cpu);
 		}
 
-		case 0xC:
-		case 0xD:
-		case 0xE:
-		case 0xF: {
-			uint8_t bit = n2 < 0x8 ? (n1 - 0x4) * 2 : (n1 - 0x4) * 2 + 1;
-			set_bit_on(*reg, bit, 1);
-			break;
+		for (int i = 0; i < GB_EVENT_COUNT; i++) {
+			if (scheduler->when[i] <= scheduler->now)
+				_handle_event(cpu, i);
 		}
 	}
 }
\ No newline at end of file
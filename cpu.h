@@ -1,10 +1,18 @@
 #ifndef cpu_h
 #define cpu_h
 
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include "ppu.h"
+#include "cart.h"
+#include "mmu.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "joypad.h"
+#include "trace.h"
+#include "flight.h"
 
 #define C 4
 #define H 5
@@ -16,8 +24,56 @@
 #define DE 2
 #define HL 3
 
+#define BLOCK_CACHE_SIZE 256
+#define BLOCK_MAX_INSTRUCTIONS 8
+#define CODE_LINE_SHIFT 6
+#define BOOT_ROM_BANK 0xffff
+#define MAX_WATCHPOINTS 8
+
+typedef struct gb_cpu gb_cpu_t;
+typedef void (*gb_opcode_t)(gb_cpu_t *cpu);
+
+typedef struct {
+	gb_opcode_t handler;
+	uint16_t imm;
+	uint8_t opcode;
+	uint8_t length;
+	uint8_t cycles;
+} gb_decoded_t;
+
+/* the last flag results, see get_flag_on in cpu.c for how each flag is read back */
+typedef struct {
+	uint16_t c;
+	uint16_t h;
+	uint8_t z;
+	bool n;
+} gb_flags_t;
+
+/* straight-line run of predecoded instructions, ending at the first one that can change pc */
 typedef struct {
+	bool valid;
+	bool pure;
+	uint8_t count;
+	uint16_t pc;
+	uint16_t bank;
+	uint16_t cycles;
+	uint32_t end;
+	gb_decoded_t instructions[BLOCK_MAX_INSTRUCTIONS];
+} gb_block_t;
+
+struct gb_cpu {
 	gb_ppu_t *ppu;
+	gb_cart_t *cart;
+	gb_scheduler_t scheduler;
+	/* ppu steps due before this cycle don't draw, frontends skipping frames move it forward */
+	uint64_t render_from;
+	gb_mmu_t mmu;
+	gb_timer_t timer;
+	gb_joypad_t joypad;
+	gb_trace_t *trace;
+	gb_flight_recorder_t *recorder;
+	uint16_t watchpoints[MAX_WATCHPOINTS];
+	uint8_t watchpoint_count;
 
 	uint8_t instruction_wait_cycles;
 	uint8_t run_mode;
@@ -26,31 +82,52 @@ typedef struct {
 	uint16_t *de;
 	uint16_t *hl;
 
-	uint8_t a;
+	/* f through pc are copied into trace records in one go, see gb_trace_record_t */
+	/* f is only current after sync_flags, the flags live in flags until something reads them */
 	uint8_t f;
-	uint8_t b;
+	uint8_t a;
 	uint8_t c;
-	uint8_t d;
+	uint8_t b;
 	uint8_t e;
-	uint8_t h;
+	uint8_t d;
 	uint8_t l;
+	uint8_t h;
 	uint16_t sp;
 	uint16_t pc;
+	gb_flags_t flags;
 	bool halt;
 	bool interrupts;
+	bool ei_delay;
+	uint16_t imm;
 
 	uint8_t *registers[8];
 
 	uint8_t addressSpace[0x10000];
 	uint8_t *ram;
-} gb_cpu_t;
-
-static inline void set_flag(gb_cpu_t *cpu, uint8_t bit, bool status);
-void init_cpu(gb_cpu_t *cpu, gb_ppu_t *ppu);
-uint32_t fetch_opcode(gb_cpu_t *cpu);
-void execute_instruction(gb_cpu_t *cpu, uint32_t instruction);
-static void _execute_instruction(gb_cpu_t *cpu, uint32_t instruction);
-static void _execute_prefix_instruction(gb_cpu_t *cpu, uint8_t next);
+	/* the image stays around after FF50 unmaps it so a save state from during boot can still load */
+	const uint8_t *boot_rom;
+	bool boot_mapped;
+
+	struct gb_jit *jit;
+	bool block_invalidated;
+	uint8_t code_lines[0x10000 >> CODE_LINE_SHIFT];
+	gb_block_t blocks[BLOCK_CACHE_SIZE];
+};
+
+void init_cpu(gb_cpu_t *cpu, gb_ppu_t *ppu, gb_cart_t *cart);
+void execute_instruction(gb_cpu_t *cpu);
+void run_until(gb_cpu_t *cpu, uint64_t target);
+uint16_t code_bank(gb_cpu_t *cpu, uint16_t pc);
+void build_block(gb_cpu_t *cpu, gb_block_t *block, uint16_t pc);
+void invalidate_code(gb_cpu_t *cpu, uint16_t address);
+void flush_ram_code(gb_cpu_t *cpu);
+bool add_watchpoint(gb_cpu_t *cpu, uint16_t address);
+void check_watchpoints(gb_cpu_t *cpu, uint16_t address);
+void request_interrupts(gb_cpu_t *cpu, uint8_t interrupts);
+void update_timer(gb_cpu_t *cpu);
+void set_buttons(gb_cpu_t *cpu, uint8_t buttons);
+void sync_flags(gb_cpu_t *cpu);
+void load_flags(gb_cpu_t *cpu);
 
 #endif
 
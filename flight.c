@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "flight.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/* crashes can't be traced back to an instance, so only the most recent recorder gets dumped */
+static gb_flight_recorder_t *volatile _crash_recorder = NULL;
+
+static bool _write_all(int file, const uint8_t *data, size_t size) {
+	while (size) {
+		ssize_t written = write(file, data, size);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return 0;
+		data += written;
+		size -= written;
+	}
+	return 1;
+}
+
+/* everything here is async signal safe, the crash handler calls it as well as flight_dump */
+static bool _dump(gb_flight_recorder_t *recorder, uint64_t *written) {
+	// oldest record first, which is the one about to be overwritten once the ring has wrapped
+	uint64_t count = recorder->count < FLIGHT_RECORDER_SIZE ? recorder->count : FLIGHT_RECORDER_SIZE;
+	size_t start = (recorder->count - count) & (FLIGHT_RECORDER_SIZE - 1);
+	size_t first = count < FLIGHT_RECORDER_SIZE - start ? count : FLIGHT_RECORDER_SIZE - start;
+	uint8_t *out = recorder->encoded;
+	out += encode_trace_header(out);
+	out += encode_trace_records(out, recorder->records + start, first);
+	out += encode_trace_records(out, recorder->records, count - first);
+	*written = count;
+
+	if (recorder->file < 0 || ftruncate(recorder->file, 0) || lseek(recorder->file, 0, SEEK_SET) < 0)
+		return 0;
+	return _write_all(recorder->file, recorder->encoded, out - recorder->encoded);
+}
+
+static void _crash(int signal_number) {
+#ifdef _WIN32
+	signal(signal_number, SIG_DFL);
+#endif
+	gb_flight_recorder_t *recorder = _crash_recorder;
+	if (recorder && !recorder->dumped) {
+		recorder->dumped = 1;
+		uint64_t count;
+		static const char message[] = "Flight recorder: crash, wrote the last block entries.\n";
+		static const char failed[] = "Flight recorder: crash, failed to write the dump.\n";
+		if (_dump(recorder, &count))
+			_write_all(2, (const uint8_t *)message, sizeof(message) - 1);
+		else
+			_write_all(2, (const uint8_t *)failed, sizeof(failed) - 1);
+	}
+	raise(signal_number);
+}
+
+static void _handle(int signal_number) {
+#ifdef _WIN32
+	signal(signal_number, _crash);
+#else
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	// back to the default once it fires, so the raise at the end of _crash ends the process
+	action.sa_handler = _crash;
+	action.sa_flags = SA_RESETHAND;
+	sigemptyset(&action.sa_mask);
+	sigaction(signal_number, &action, NULL);
+#endif
+}
+
+/*
+ * the file is created here without truncating it, so a dump from an earlier run survives until
+ * this one has something to replace it with
+ */
+gb_flight_recorder_t *open_flight_recorder(const char *path) {
+	gb_flight_recorder_t *recorder = malloc(sizeof(gb_flight_recorder_t));
+	if (!recorder)
+		return NULL;
+	recorder->path = path;
+	recorder->file = open(path, O_WRONLY | O_CREAT | O_BINARY, 0644);
+	recorder->dumped = 0;
+	recorder->count = 0;
+	if (recorder->file < 0)
+		fprintf(stderr, "Flight recorder: failed to open %s.\n", path);
+
+	_crash_recorder = recorder;
+	_handle(SIGSEGV);
+	_handle(SIGILL);
+	_handle(SIGFPE);
+	_handle(SIGABRT);
+	return recorder;
+}
+
+void close_flight_recorder(gb_flight_recorder_t *recorder) {
+	if (_crash_recorder == recorder)
+		_crash_recorder = NULL;
+	if (recorder->file >= 0)
+		close(recorder->file);
+	free(recorder);
+}
+
+/* only the first failure is written, later ones would just bury it */
+void flight_dump(gb_flight_recorder_t *recorder, const char *reason) {
+	if (recorder->dumped)
+		return;
+	recorder->dumped = 1;
+
+	uint64_t count;
+	if (_dump(recorder, &count))
+		fprintf(stderr, "Flight recorder: %s, wrote the last %llu block entries to %s.\n", reason, (unsigned long long)count, recorder->path);
+	else
+		fprintf(stderr, "Flight recorder: %s, failed to write %s.\n", reason, recorder->path);
+}
@@ -0,0 +1,39 @@
+#ifndef flight_h
+#define flight_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include "trace.h"
+
+#define FLIGHT_RECORDER_SIZE (1 << 16)
+
+/*
+ * the last FLIGHT_RECORDER_SIZE instructions, kept in memory all the time and only written out,
+ * in the trace file format, when something goes wrong
+ */
+/* the dump is two runs of the ring once it has wrapped, which costs at most one more chunk */
+#define FLIGHT_ENCODED_SIZE (sizeof(gb_trace_header_t) + TRACE_ENCODED_BOUND(FLIGHT_RECORDER_SIZE + TRACE_CHUNK_RECORDS))
+
+/*
+ * the file is opened up front and the dump is encoded into memory set aside for it, so writing it
+ * from the crash handler only takes write calls and never touches the heap or stdio
+ */
+typedef struct {
+	const char *path;
+	int file;
+	volatile sig_atomic_t dumped;
+	uint64_t count;
+	gb_trace_record_t records[FLIGHT_RECORDER_SIZE];
+	uint8_t encoded[FLIGHT_ENCODED_SIZE];
+} gb_flight_recorder_t;
+
+gb_flight_recorder_t *open_flight_recorder(const char *path);
+void close_flight_recorder(gb_flight_recorder_t *recorder);
+void flight_dump(gb_flight_recorder_t *recorder, const char *reason);
+
+static inline gb_trace_record_t *flight_record(gb_flight_recorder_t *recorder) {
+	return &recorder->records[recorder->count++ & (FLIGHT_RECORDER_SIZE - 1)];
+}
+
+#endif
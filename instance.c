@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include "instance.h"
+#include "rom.h"
+#include "jit.h"
+#include "savestate.h"
+
+gb_instance_t *open_instance(const char *boot_path, bool jit) {
+	gb_instance_t *instance = malloc(sizeof(gb_instance_t));
+	if (!instance)
+		return NULL;
+	if (!map_file(&instance->boot, boot_path, 1) || instance->boot.file_size < 0x100) {
+		err("Failed to open the boot rom.\n");
+		free(instance);
+		return NULL;
+	}
+	instance->loaded = 0;
+	instance->use_jit = jit;
+	instance->jit = NULL;
+	instance->frame_end = 0;
+	return instance;
+}
+
+void close_instance(gb_instance_t *instance) {
+	if (instance->jit)
+		free_jit(instance->jit);
+	if (instance->loaded) {
+		free_cart(&instance->cart);
+		unmap_file(&instance->rom);
+	}
+	unmap_file(&instance->boot);
+	free(instance);
+}
+
+/*
+ * powers the machine back on, with a new rom when rom_path is given or the last one otherwise.
+ * a state, if there is one, is loaded on top, so episodes can all start from the same point
+ */
+bool instance_reset(gb_instance_t *instance, const char *rom_path, const uint8_t *state, size_t size) {
+	gb_cpu_t *cpu = &instance->cpu;
+	if (instance->loaded)
+		free_cart(&instance->cart);
+	if (rom_path) {
+		if (instance->loaded)
+			unmap_file(&instance->rom);
+		instance->loaded = map_file(&instance->rom, rom_path, ROM_BANK_SIZE);
+		if (instance->loaded && instance->rom.file_size < 0x150) {
+			unmap_file(&instance->rom);
+			instance->loaded = 0;
+		}
+	}
+	if (!instance->loaded)
+		return 0;
+	if (!init_cart(&instance->cart, instance->rom.data, instance->rom.size)) {
+		unmap_file(&instance->rom);
+		instance->loaded = 0;
+		return 0;
+	}
+
+	init_ppu(&instance->ppu);
+	init_cpu(cpu, &instance->ppu, &instance->cart);
+	instance->frame_end = 0;
+	// the jit outlives resets but starts over cold, when blocks get compiled changes where frames end
+	if (instance->jit)
+		jit_reset(instance->jit);
+	else if (instance->use_jit)
+		instance->jit = init_jit(cpu, 0);
+	cpu->jit = instance->jit;
+	const struct rom_header *header = (const struct rom_header *)(instance->rom.data + 0x100);
+	if (header->old_license_code == 0x33)
+		cpu->run_mode = header->sgb_flag == 0x03 ? 2 : 1;
+	cpu->boot_rom = instance->boot.data;
+	cpu->boot_mapped = 1;
+	mmu_map_boot(cpu);
+
+	if (!state)
+		return 1;
+	if (!load_state(cpu, state, size))
+		return 0;
+	// run_until stops on the first instruction past its target, so a loaded state goes back to its frame boundary
+	instance->frame_end = cpu->scheduler.now - cpu->scheduler.now % CYCLES_PER_FRAME;
+	return 1;
+}
+
+/*
+ * runs frameskip frames with the buttons held. only lines due in the last frame are drawn: while
+ * the lcd is on each line is redrawn once a frame, and switching it off blanks the screen, so
+ * either way it ends up exactly as if all of them had been
+ */
+void instance_step(gb_instance_t *instance, uint8_t buttons, int frameskip) {
+	if (frameskip < 1)
+		frameskip = 1;
+	set_buttons(&instance->cpu, buttons);
+	instance->cpu.render_from = instance->frame_end + (uint64_t)(frameskip - 1) * CYCLES_PER_FRAME;
+	for (int i = 0; i < frameskip; i++) {
+		instance->frame_end += CYCLES_PER_FRAME;
+		run_until(&instance->cpu, instance->frame_end);
+	}
+}
+
+/* the live indexed framebuffer, see gb_ppu_t for the pixel format. it's only valid between steps */
+const uint8_t (*instance_framebuffer(gb_instance_t *instance))[LCD_WIDTH] {
+	return (const uint8_t (*)[LCD_WIDTH])instance->ppu.framebuffer;
+}
+
+/* the 8 KiB of work ram at 0xc000, live like the framebuffer */
+const uint8_t *instance_wram(gb_instance_t *instance) {
+	return instance->cpu.ram;
+}
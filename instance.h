@@ -0,0 +1,35 @@
+#ifndef instance_h
+#define instance_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "cpu.h"
+#include "utils.h"
+
+/*
+ * a whole machine behind a small api for driving it from other programs: reset it to power on or
+ * to a saved state, step it some frames with the buttons held, then read the screen and work ram
+ * in place. everything lives in the one allocation, so any number of instances can run side by side
+ */
+typedef struct {
+	gb_cpu_t cpu;
+	gb_ppu_t ppu;
+	gb_cart_t cart;
+	gb_mapping_t rom;
+	gb_mapping_t boot;
+	bool loaded;
+	bool use_jit;
+	struct gb_jit *jit;
+	uint64_t frame_end;
+} gb_instance_t;
+
+gb_instance_t *open_instance(const char *boot_path, bool jit);
+void close_instance(gb_instance_t *instance);
+/* false when the rom or the state can't be used, a bad state still leaves the machine at power on */
+bool instance_reset(gb_instance_t *instance, const char *rom_path, const uint8_t *state, size_t size);
+void instance_step(gb_instance_t *instance, uint8_t buttons, int frameskip);
+const uint8_t (*instance_framebuffer(gb_instance_t *instance))[LCD_WIDTH];
+const uint8_t *instance_wram(gb_instance_t *instance);
+
+#endif
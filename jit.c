@@ -0,0 +1,653 @@
+#include <stdio.h>
+#include <string.h>
+#include "jit.h"
+#include "utils.h"
+
+/*
+ * x86-64 translation of hot blocks. Register moves, immediate loads, 16-bit inc/dec and
+ * jr/jp are emitted natively with the guest registers cached in host registers, everything
+ * else calls the interpreter handler for that opcode. Blocks chain straight into each other
+ * while the scheduler budget allows and the whole cache is dropped when code is written.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RBP 5
+#define R8 8
+#define R9 9
+#define R10 10
+#define R12 12
+#define R13 13
+#define R14 14
+#define R15 15
+
+/* host register holding each guest register, in operand order b, c, d, e, h, l, (hl), a */
+static const uint8_t _host[8] = {R14, R15, RBP, R8, R9, R10, 0, R13};
+
+static const size_t _guest[8] = {
+	offsetof(gb_cpu_t, b), offsetof(gb_cpu_t, c), offsetof(gb_cpu_t, d), offsetof(gb_cpu_t, e),
+	offsetof(gb_cpu_t, h), offsetof(gb_cpu_t, l), 0, offsetof(gb_cpu_t, a)
+};
+
+#define OFFSET_NOW (offsetof(gb_cpu_t, scheduler) + offsetof(gb_scheduler_t, now))
+
+typedef struct {
+	uint8_t *p;
+	bool loaded[8];
+	bool dirty[8];
+} gb_emitter_t;
+
+static inline void _emit8(gb_emitter_t *e, uint8_t value) {
+	*e->p++ = value;
+}
+
+static inline void _emit16(gb_emitter_t *e, uint16_t value) {
+	memcpy(e->p, &value, 2);
+	e->p += 2;
+}
+
+static inline void _emit32(gb_emitter_t *e, uint32_t value) {
+	memcpy(e->p, &value, 4);
+	e->p += 4;
+}
+
+static inline void _emit64(gb_emitter_t *e, uint64_t value) {
+	memcpy(e->p, &value, 8);
+	e->p += 8;
+}
+
+// modrm for [rbx + disp32]
+static inline void _emit_mem(gb_emitter_t *e, uint8_t reg, size_t offset) {
+	_emit8(e, 0x80 | (reg & 7) << 3 | RBX);
+	_emit32(e, (uint32_t)offset);
+}
+
+static inline void _patch_rel32(uint8_t *at, uint8_t *target) {
+	int32_t rel = (int32_t)(target - (at + 4));
+	memcpy(at, &rel, 4);
+}
+
+// movzx reg32, byte [rbx + offset]
+static void _emit_load8(gb_emitter_t *e, uint8_t reg, size_t offset) {
+	if (reg >= 8)
+		_emit8(e, 0x44);
+	_emit8(e, 0x0f);
+	_emit8(e, 0xb6);
+	_emit_mem(e, reg, offset);
+}
+
+// mov byte [rbx + offset], reg8
+static void _emit_store8(gb_emitter_t *e, uint8_t reg, size_t offset) {
+	_emit8(e, 0x40 | (reg >= 8 ? 4 : 0));
+	_emit8(e, 0x88);
+	_emit_mem(e, reg, offset);
+}
+
+// mov dst32, src32
+static void _emit_mov(gb_emitter_t *e, uint8_t dst, uint8_t src) {
+	uint8_t rex = 0x40 | (src >= 8 ? 4 : 0) | (dst >= 8 ? 1 : 0);
+	if (rex != 0x40)
+		_emit8(e, rex);
+	_emit8(e, 0x89);
+	_emit8(e, 0xc0 | (src & 7) << 3 | (dst & 7));
+}
+
+// mov dst32, imm32
+static void _emit_mov_imm(gb_emitter_t *e, uint8_t dst, uint32_t value) {
+	if (dst >= 8)
+		_emit8(e, 0x41);
+	_emit8(e, 0xb8 + (dst & 7));
+	_emit32(e, value);
+}
+
+// mov word [rbx + offset], imm16
+static void _emit_store16_imm(gb_emitter_t *e, size_t offset, uint16_t value) {
+	_emit8(e, 0x66);
+	_emit8(e, 0xc7);
+	_emit_mem(e, 0, offset);
+	_emit16(e, value);
+}
+
+// mov byte [rbx + offset], imm8
+static void _emit_store8_imm(gb_emitter_t *e, size_t offset, uint8_t value) {
+	_emit8(e, 0xc6);
+	_emit_mem(e, 0, offset);
+	_emit8(e, value);
+}
+
+// add qword [rbx + now], imm32
+static void _emit_add_cycles(gb_emitter_t *e, uint32_t cycles) {
+	if (!cycles)
+		return;
+	_emit8(e, 0x48);
+	_emit8(e, 0x81);
+	_emit_mem(e, 0, OFFSET_NOW);
+	_emit32(e, cycles);
+}
+
+// jcc rel32 (or jmp when cc is 0), returns the address of the rel32 for patching
+static uint8_t *_emit_jump(gb_emitter_t *e, uint8_t cc, uint8_t *target) {
+	if (cc) {
+		_emit8(e, 0x0f);
+		_emit8(e, cc);
+	} else {
+		_emit8(e, 0xe9);
+	}
+	uint8_t *at = e->p;
+	_emit32(e, 0);
+	if (target)
+		_patch_rel32(at, target);
+	return at;
+}
+
+#define JCC_JB 0x82
+#define JCC_JAE 0x83
+#define JCC_JE 0x84
+#define JCC_JNE 0x85
+
+static uint8_t _use(gb_emitter_t *e, uint8_t r) {
+	if (!e->loaded[r]) {
+		_emit_load8(e, _host[r], _guest[r]);
+		e->loaded[r] = 1;
+	}
+	return _host[r];
+}
+
+static void _define(gb_emitter_t *e, uint8_t r) {
+	e->loaded[r] = 1;
+	e->dirty[r] = 1;
+}
+
+static void _flush_registers(gb_emitter_t *e) {
+	for (int r = 0; r < 8; r++) {
+		if (e->dirty[r])
+			_emit_store8(e, _host[r], _guest[r]);
+		e->dirty[r] = 0;
+	}
+}
+
+static void _forget_registers(gb_emitter_t *e) {
+	for (int r = 0; r < 8; r++)
+		e->loaded[r] = 0;
+}
+
+static void _emit_call(gb_emitter_t *e, gb_opcode_t handler) {
+	_emit8(e, 0x48);
+	_emit8(e, 0xb8);
+	_emit64(e, (uint64_t)(uintptr_t)handler);
+#ifdef _WIN32
+	_emit8(e, 0x48); _emit8(e, 0x89); _emit8(e, 0xd9); // mov rcx, rbx
+#else
+	_emit8(e, 0x48); _emit8(e, 0x89); _emit8(e, 0xdf); // mov rdi, rbx
+#endif
+	_emit8(e, 0xff); _emit8(e, 0xd0); // call rax
+}
+
+// 16-bit inc/dec of a register pair held as two zero-extended bytes
+static void _emit_pair_step(gb_emitter_t *e, uint8_t high, uint8_t low, bool decrement) {
+	uint8_t hi = _use(e, high);
+	uint8_t lo = _use(e, low);
+
+	_emit_mov(e, RAX, hi);
+	_emit8(e, 0xc1); _emit8(e, 0xe0); _emit8(e, 0x08); // shl eax, 8
+	if (lo >= 8)
+		_emit8(e, 0x44);
+	_emit8(e, 0x09); _emit8(e, 0xc0 | (lo & 7) << 3); // or eax, lo
+	_emit8(e, 0xff); _emit8(e, decrement ? 0xc8 : 0xc0); // inc/dec eax
+	if (lo >= 8)
+		_emit8(e, 0x44);
+	_emit8(e, 0x0f); _emit8(e, 0xb6); _emit8(e, 0xc0 | (lo & 7) << 3); // movzx lo, al
+	_emit8(e, 0xc1); _emit8(e, 0xe8); _emit8(e, 0x08); // shr eax, 8
+	_emit8(e, 0x0f); _emit8(e, 0xb6); _emit8(e, 0xc0); // movzx eax, al
+	_emit_mov(e, hi, RAX);
+	_define(e, high);
+	_define(e, low);
+}
+
+/* native forms of the instructions that don't touch flags or memory, false if it needs the handler */
+static bool _emit_native(gb_emitter_t *e, const gb_decoded_t *decoded) {
+	uint8_t opcode = decoded->opcode;
+
+	if (opcode == 0x00)
+		return 1;
+
+	if (opcode >= 0x40 && opcode < 0x80 && opcode != 0x76) {
+		uint8_t dst = (opcode >> 3) & 7;
+		uint8_t src = opcode & 7;
+		if (dst == 6 || src == 6)
+			return 0;
+		if (dst != src) {
+			_emit_mov(e, _host[dst], _use(e, src));
+			_define(e, dst);
+		}
+		return 1;
+	}
+
+	switch (opcode) {
+		case 0x06: case 0x0e: case 0x16: case 0x1e: case 0x26: case 0x2e: case 0x3e: {
+			uint8_t dst = (opcode >> 3) & 7;
+			_emit_mov_imm(e, _host[dst], decoded->imm & 0xff);
+			_define(e, dst);
+			return 1;
+		}
+		case 0x01: case 0x11: case 0x21: {
+			uint8_t high = (opcode >> 4) * 2;
+			_emit_mov_imm(e, _host[high], decoded->imm >> 8);
+			_emit_mov_imm(e, _host[high + 1], decoded->imm & 0xff);
+			_define(e, high);
+			_define(e, high + 1);
+			return 1;
+		}
+		case 0x31: {
+			_emit_store16_imm(e, offsetof(gb_cpu_t, sp), decoded->imm);
+			return 1;
+		}
+		case 0x03: case 0x13: case 0x23:
+		case 0x0b: case 0x1b: case 0x2b: {
+			uint8_t high = (opcode >> 4) * 2;
+			_emit_pair_step(e, high, high + 1, opcode & 0x08);
+			return 1;
+		}
+		case 0x33: case 0x3b: {
+			_emit8(e, 0x66); _emit8(e, 0xff);
+			_emit_mem(e, opcode == 0x3b ? 1 : 0, offsetof(gb_cpu_t, sp)); // inc/dec word [rbx + sp]
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* static exit, pc and cycles are known here so the jump can later be linked to the target block */
+static void _emit_exit(gb_jit_t *jit, gb_emitter_t *e, gb_jit_exit_t *exit, uint32_t cycles, uint16_t target) {
+	_emit_add_cycles(e, cycles);
+	_emit_store16_imm(e, offsetof(gb_cpu_t, pc), target);
+	exit->patch = _emit_jump(e, 0, jit->epilogue);
+	exit->target = target;
+}
+
+static inline unsigned _slot(uint16_t pc, uint16_t bank) {
+	return (pc ^ (pc >> 12) ^ (bank << 4)) & (JIT_TABLE_SIZE - 1);
+}
+
+static void _flush(gb_jit_t *jit) {
+	jit->used = jit->base;
+	jit->generation++;
+	jit->compiled = 0;
+	jit->flush_pending = 0;
+}
+
+static inline bool _banked(uint16_t pc) {
+	return pc < 0x8000 || (pc >= 0xa000 && pc < 0xc000);
+}
+
+static inline int _region(uint16_t pc) {
+	return pc < 0x8000 ? pc >> 14 : pc >> 13;
+}
+
+/*
+ * a bank switch always ends the running block, so a jump within one bank window can stay
+ * linked, but a jump into a window from anywhere else has to see the bank through the dispatcher
+ */
+static inline bool _can_link(const gb_jit_block_t *source, const gb_jit_block_t *target) {
+	if (!_banked(target->pc))
+		return 1;
+	return _region(source->pc) == _region(target->pc) && source->bank == target->bank;
+}
+
+static void _link(gb_jit_t *jit, gb_jit_block_t *block) {
+	if (jit->verify)
+		return;
+
+	for (int i = 0; i < 2; i++) {
+		gb_jit_exit_t *exit = &block->exits[i];
+		if (!exit->patch)
+			continue;
+		uint16_t bank = code_bank(jit->cpu, exit->target);
+		gb_jit_block_t *target = &jit->blocks[_slot(exit->target, bank)];
+		if (target->generation == jit->generation && target->pc == exit->target && target->bank == bank && _can_link(block, target)) {
+			_patch_rel32(exit->patch, target->entry);
+			exit->patch = NULL;
+		}
+	}
+
+	// only blocks compiled since the last flush can have exits waiting on this one
+	for (size_t i = 0; i < jit->compiled; i++) {
+		gb_jit_block_t *other = &jit->blocks[jit->order[i]];
+		if (other->generation != jit->generation)
+			continue;
+		for (int j = 0; j < 2; j++) {
+			gb_jit_exit_t *exit = &other->exits[j];
+			if (exit->patch && exit->target == block->pc && _can_link(other, block)) {
+				_patch_rel32(exit->patch, block->entry);
+				exit->patch = NULL;
+			}
+		}
+	}
+}
+
+static void _compile(gb_jit_t *jit, gb_jit_block_t *slot, uint16_t pc) {
+	gb_cpu_t *cpu = jit->cpu;
+	gb_block_t block;
+	build_block(cpu, &block, pc);
+
+	if (jit->used + JIT_MAX_BLOCK_BYTES > JIT_CODE_SIZE)
+		_flush(jit);
+
+	gb_emitter_t emitter = {jit->code + jit->used};
+	gb_emitter_t *e = &emitter;
+	const gb_decoded_t *last = &block.instructions[block.count - 1];
+
+	slot->pc = pc;
+	slot->bank = block.bank;
+	slot->prefix_cycles = block.cycles - last->cycles;
+	slot->entry = e->p;
+	slot->exits[0].patch = NULL;
+	slot->exits[1].patch = NULL;
+
+	// bail out before starting if the last instruction would begin past the budget in r12
+	_emit8(e, 0x48); _emit8(e, 0x8b); _emit_mem(e, RAX, OFFSET_NOW); // mov rax, [rbx + now]
+	_emit8(e, 0x48); _emit8(e, 0x05); _emit32(e, slot->prefix_cycles); // add rax, imm32
+	_emit8(e, 0x4c); _emit8(e, 0x39); _emit8(e, 0xe0); // cmp rax, r12
+	_emit_jump(e, JCC_JAE, jit->epilogue);
+
+	uint32_t cycles = 0;
+	uint16_t address = pc;
+	for (int i = 0; i < block.count; i++) {
+		const gb_decoded_t *decoded = &block.instructions[i];
+		uint16_t next = address + decoded->length;
+		address = next;
+
+		if (_emit_native(e, decoded)) {
+			cycles += decoded->cycles;
+			if (decoded == last)
+				_flush_registers(e), _emit_exit(jit, e, &slot->exits[0], cycles, next);
+			continue;
+		}
+
+		uint8_t opcode = decoded->opcode;
+		if (opcode == 0x18 || opcode == 0xc3) {
+			_flush_registers(e);
+			uint16_t target = opcode == 0x18 ? next + (int8_t)decoded->imm : decoded->imm;
+			_emit_exit(jit, e, &slot->exits[0], cycles + (opcode == 0x18 ? 12 : 16), target);
+			break;
+		}
+
+		if (opcode == 0x20 || opcode == 0x28 || opcode == 0x30 || opcode == 0x38) {
+			// jr cc: bit 3 of the opcode selects the set form, either way zf ends up set when the flag is
+			_flush_registers(e);
+			bool carry = opcode >= 0x30;
+			if (carry) {
+				// c is bit 8 of flags.c, zf is set when it is clear so the sense is flipped below
+				_emit8(e, 0xf6); _emit_mem(e, 0, offsetof(gb_cpu_t, flags.c) + 1); _emit8(e, 1); // test byte [rbx + flags.c + 1], 1
+			} else {
+				_emit8(e, 0x80); _emit_mem(e, 7, offsetof(gb_cpu_t, flags.z)); _emit8(e, 0); // cmp byte [rbx + flags.z], 0
+			}
+			uint8_t *skip = _emit_jump(e, (opcode & 0x08) == (carry ? 0x08 : 0) ? JCC_JE : JCC_JNE, NULL);
+			_emit_exit(jit, e, &slot->exits[0], cycles + 12, next + (int8_t)decoded->imm);
+			_patch_rel32(skip, e->p);
+			_emit_exit(jit, e, &slot->exits[1], cycles + 8, next);
+			break;
+		}
+
+		// everything else goes through the interpreter handler with the guest state in memory. the
+		// clock is brought up to the start of the instruction first, the timer and lcd handlers read it
+		_flush_registers(e);
+		_forget_registers(e);
+		_emit_add_cycles(e, cycles);
+		cycles = 0;
+		_emit_store16_imm(e, offsetof(gb_cpu_t, pc), next);
+		_emit_store16_imm(e, offsetof(gb_cpu_t, imm), decoded->imm);
+		_emit_store8_imm(e, offsetof(gb_cpu_t, instruction_wait_cycles), decoded->cycles);
+		_emit_call(e, decoded->handler);
+
+		if (decoded == last) {
+			// pc and the cycle count are whatever the handler decided, illegal opcodes take 4
+			_emit8(e, 0x0f); _emit8(e, 0xb6); _emit_mem(e, RAX, offsetof(gb_cpu_t, instruction_wait_cycles));
+			_emit8(e, 0x85); _emit8(e, 0xc0); // test eax, eax
+			_emit8(e, 0x75); _emit8(e, 0x05); // jnz +5
+			_emit_mov_imm(e, RAX, 4);
+			_emit8(e, 0x05); _emit32(e, cycles); // add eax, imm32
+			_emit8(e, 0x48); _emit8(e, 0x01); _emit_mem(e, RAX, OFFSET_NOW); // add [rbx + now], rax
+			_emit_jump(e, 0, jit->epilogue);
+			break;
+		}
+
+		cycles += decoded->cycles;
+		_emit8(e, 0x80); _emit_mem(e, 7, offsetof(gb_cpu_t, block_invalidated)); _emit8(e, 0); // cmp byte [rbx + block_invalidated], 0
+		uint8_t *skip = _emit_jump(e, JCC_JE, NULL);
+		_emit_add_cycles(e, cycles);
+		_emit_jump(e, 0, jit->epilogue);
+		_patch_rel32(skip, e->p);
+	}
+
+	jit->used = e->p - jit->code;
+	slot->generation = jit->generation;
+	if (jit->compiled < JIT_TABLE_SIZE)
+		jit->order[jit->compiled++] = slot - jit->blocks;
+	_link(jit, slot);
+}
+
+static void _emit_trampoline(gb_jit_t *jit) {
+	gb_emitter_t emitter = {jit->code};
+	gb_emitter_t *e = &emitter;
+
+	void *enter = e->p;
+	_emit8(e, 0x53); // push rbx
+	_emit8(e, 0x55); // push rbp
+	_emit8(e, 0x41); _emit8(e, 0x54); // push r12
+	_emit8(e, 0x41); _emit8(e, 0x55); // push r13
+	_emit8(e, 0x41); _emit8(e, 0x56); // push r14
+	_emit8(e, 0x41); _emit8(e, 0x57); // push r15
+	_emit8(e, 0x48); _emit8(e, 0x83); _emit8(e, 0xec); _emit8(e, 0x28); // sub rsp, 40
+#ifdef _WIN32
+	_emit8(e, 0x48); _emit8(e, 0x89); _emit8(e, 0xcb); // mov rbx, rcx
+	_emit8(e, 0x49); _emit8(e, 0x89); _emit8(e, 0xd4); // mov r12, rdx
+	_emit8(e, 0x41); _emit8(e, 0xff); _emit8(e, 0xe0); // jmp r8
+#else
+	_emit8(e, 0x48); _emit8(e, 0x89); _emit8(e, 0xfb); // mov rbx, rdi
+	_emit8(e, 0x49); _emit8(e, 0x89); _emit8(e, 0xf4); // mov r12, rsi
+	_emit8(e, 0xff); _emit8(e, 0xe2); // jmp rdx
+#endif
+
+	jit->epilogue = e->p;
+	_emit8(e, 0x48); _emit8(e, 0x83); _emit8(e, 0xc4); _emit8(e, 0x28); // add rsp, 40
+	_emit8(e, 0x41); _emit8(e, 0x5f); // pop r15
+	_emit8(e, 0x41); _emit8(e, 0x5e); // pop r14
+	_emit8(e, 0x41); _emit8(e, 0x5d); // pop r13
+	_emit8(e, 0x41); _emit8(e, 0x5c); // pop r12
+	_emit8(e, 0x5d); // pop rbp
+	_emit8(e, 0x5b); // pop rbx
+	_emit8(e, 0xc3); // ret
+
+	memcpy(&jit->enter, &enter, sizeof(enter));
+	jit->base = jit->used = e->p - jit->code;
+}
+
+/* differential mode, the interpreter replays every native block on a shadow cpu */
+
+static void _copy_state(gb_cpu_t *to, const gb_cpu_t *from) {
+	to->f = from->f;
+	to->flags = from->flags;
+	to->a = from->a;
+	to->b = from->b;
+	to->c = from->c;
+	to->d = from->d;
+	to->e = from->e;
+	to->h = from->h;
+	to->l = from->l;
+	to->sp = from->sp;
+	to->pc = from->pc;
+	to->halt = from->halt;
+	to->interrupts = from->interrupts;
+	to->ei_delay = from->ei_delay;
+	to->scheduler = from->scheduler;
+	to->timer = from->timer;
+	to->joypad = from->joypad;
+	to->boot_rom = from->boot_rom;
+	to->boot_mapped = from->boot_mapped;
+	memcpy(to->addressSpace, from->addressSpace, sizeof(to->addressSpace));
+	memcpy(to->ppu, from->ppu, offsetof(gb_ppu_t, framebuffer));
+
+	// the shadow cart shares the rom but keeps its own ram
+	uint8_t *ram = to->cart->ram;
+	*to->cart = *from->cart;
+	to->cart->ram = ram;
+	if (ram) {
+		memcpy(ram, from->cart->ram, from->cart->ram_banks * RAM_BANK_SIZE);
+		if (from->cart->ram_map)
+			to->cart->ram_map = ram + (from->cart->ram_map - from->cart->ram);
+	}
+	mmu_map_cart(to);
+}
+
+static bool _same_cart(const gb_cart_t *a, const gb_cart_t *b) {
+	return a->rom_bank[0] == b->rom_bank[0] && a->rom_bank[1] == b->rom_bank[1] && a->ram_bank == b->ram_bank &&
+		a->ram_enabled == b->ram_enabled && a->rtc_select == b->rtc_select &&
+		(!a->ram || !memcmp(a->ram, b->ram, a->ram_banks * RAM_BANK_SIZE));
+}
+
+static bool _same_timer(const gb_timer_t *a, const gb_timer_t *b) {
+	return a->base == b->base && a->synced == b->synced && a->tima == b->tima && a->tma == b->tma &&
+		a->tac == b->tac && a->interrupts == b->interrupts;
+}
+
+static void _verify(gb_jit_t *jit, uint16_t pc) {
+	gb_cpu_t *cpu = jit->cpu;
+	gb_cpu_t *shadow = jit->shadow;
+
+	while (shadow->scheduler.now < cpu->scheduler.now) {
+		execute_instruction(shadow);
+		shadow->scheduler.now += shadow->instruction_wait_cycles ? shadow->instruction_wait_cycles : 4;
+	}
+	sync_flags(cpu);
+	sync_flags(shadow);
+
+	if (shadow->scheduler.now == cpu->scheduler.now && shadow->pc == cpu->pc && shadow->sp == cpu->sp &&
+		*shadow->af == *cpu->af && *shadow->bc == *cpu->bc && *shadow->de == *cpu->de && *shadow->hl == *cpu->hl &&
+		shadow->halt == cpu->halt && shadow->interrupts == cpu->interrupts && shadow->ei_delay == cpu->ei_delay &&
+		_same_timer(&shadow->timer, &cpu->timer) && !memcmp(&shadow->joypad, &cpu->joypad, sizeof(cpu->joypad)) &&
+		shadow->boot_mapped == cpu->boot_mapped && _same_cart(shadow->cart, cpu->cart) &&
+		!memcmp(shadow->ppu, cpu->ppu, offsetof(gb_ppu_t, framebuffer)) &&
+		!memcmp(shadow->addressSpace, cpu->addressSpace, sizeof(cpu->addressSpace)))
+		return;
+
+	fprintf(stderr, "jit mismatch in block at 0x%04x\n", pc);
+	fprintf(stderr, "  jit:         pc 0x%04x sp 0x%04x af 0x%04x bc 0x%04x de 0x%04x hl 0x%04x cycles %llu\n",
+		cpu->pc, cpu->sp, *cpu->af, *cpu->bc, *cpu->de, *cpu->hl, (unsigned long long)cpu->scheduler.now);
+	fprintf(stderr, "  interpreter: pc 0x%04x sp 0x%04x af 0x%04x bc 0x%04x de 0x%04x hl 0x%04x cycles %llu\n",
+		shadow->pc, shadow->sp, *shadow->af, *shadow->bc, *shadow->de, *shadow->hl, (unsigned long long)shadow->scheduler.now);
+	abort();
+}
+
+gb_jit_t *init_jit(gb_cpu_t *cpu, bool verify) {
+	gb_jit_t *jit = calloc(1, sizeof(gb_jit_t));
+	if (!jit)
+		return NULL;
+
+#ifdef _WIN32
+	jit->code = VirtualAlloc(NULL, JIT_CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+	jit->code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (jit->code == MAP_FAILED)
+		jit->code = NULL;
+#endif
+	if (!jit->code) {
+		err("Failed to allocate jit code buffer.\n");
+		free(jit);
+		return NULL;
+	}
+
+	jit->cpu = cpu;
+	jit->verify = verify;
+	if (verify) {
+		jit->shadow_cart = *cpu->cart;
+		jit->shadow_cart.ram = cpu->cart->ram ? malloc(cpu->cart->ram_banks * RAM_BANK_SIZE) : NULL;
+		jit->shadow = malloc(sizeof(gb_cpu_t));
+		init_cpu(jit->shadow, &jit->shadow_ppu, &jit->shadow_cart);
+	}
+
+	_emit_trampoline(jit);
+	_flush(jit);
+	return jit;
+}
+
+void free_jit(gb_jit_t *jit) {
+#ifdef _WIN32
+	VirtualFree(jit->code, 0, MEM_RELEASE);
+#else
+	munmap(jit->code, JIT_CODE_SIZE);
+#endif
+	if (jit->shadow)
+		free_cart(&jit->shadow_cart);
+	free(jit->shadow);
+	free(jit);
+}
+
+bool jit_execute(gb_jit_t *jit, uint64_t limit) {
+	gb_cpu_t *cpu = jit->cpu;
+	if (jit->flush_pending)
+		_flush(jit);
+
+	uint16_t pc = cpu->pc;
+	uint16_t bank = code_bank(cpu, pc);
+	unsigned index = _slot(pc, bank);
+	gb_jit_block_t *block = &jit->blocks[index];
+	if (block->generation != jit->generation || block->pc != pc || block->bank != bank) {
+		if (++jit->heat[index] < JIT_HOT_THRESHOLD)
+			return 0;
+		jit->heat[index] = 0;
+		_compile(jit, block, pc);
+	}
+
+	if (cpu->scheduler.now + block->prefix_cycles >= limit)
+		return 0;
+
+	cpu->block_invalidated = 0;
+	if (jit->verify)
+		_copy_state(jit->shadow, cpu);
+	jit->enter(cpu, limit, block->entry);
+	if (jit->verify)
+		_verify(jit, pc);
+	return 1;
+}
+
+void jit_invalidate(gb_jit_t *jit) {
+	// native code may still be running, the flush happens on the next dispatch
+	jit->flush_pending = 1;
+}
+
+/* back to how init_jit left it, blocks get hot at the same points so a restarted machine runs like a fresh one */
+void jit_reset(gb_jit_t *jit) {
+	_flush(jit);
+	memset(jit->heat, 0, sizeof(jit->heat));
+}
+
+#else
+
+gb_jit_t *init_jit(gb_cpu_t *cpu, bool verify) {
+	err("The jit is only available on x86-64 hosts.\n");
+	return NULL;
+}
+
+void free_jit(gb_jit_t *jit) {}
+
+bool jit_execute(gb_jit_t *jit, uint64_t limit) {
+	return 0;
+}
+
+void jit_invalidate(gb_jit_t *jit) {}
+
+void jit_reset(gb_jit_t *jit) {}
+
+#endif
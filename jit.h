@@ -0,0 +1,55 @@
+#ifndef jit_h
+#define jit_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+
+#define JIT_CODE_SIZE (4 << 20)
+#define JIT_MAX_BLOCK_BYTES 4096
+#define JIT_TABLE_SIZE 4096
+#define JIT_HOT_THRESHOLD 8
+
+typedef struct {
+	uint8_t *patch;
+	uint16_t target;
+} gb_jit_exit_t;
+
+typedef struct {
+	uint32_t generation;
+	uint16_t pc;
+	uint16_t bank;
+	uint16_t prefix_cycles;
+	uint8_t *entry;
+	gb_jit_exit_t exits[2];
+} gb_jit_block_t;
+
+typedef struct gb_jit {
+	gb_cpu_t *cpu;
+	gb_cpu_t *shadow;
+	gb_cart_t shadow_cart;
+	gb_ppu_t shadow_ppu;
+	bool verify;
+	bool flush_pending;
+	uint32_t generation;
+
+	uint8_t *code;
+	size_t used;
+	size_t base;
+	uint8_t *epilogue;
+	void (*enter)(gb_cpu_t *cpu, uint64_t limit, uint8_t *entry);
+
+	uint8_t heat[JIT_TABLE_SIZE];
+	uint16_t order[JIT_TABLE_SIZE];
+	size_t compiled;
+	gb_jit_block_t blocks[JIT_TABLE_SIZE];
+} gb_jit_t;
+
+gb_jit_t *init_jit(gb_cpu_t *cpu, bool verify);
+void free_jit(gb_jit_t *jit);
+bool jit_execute(gb_jit_t *jit, uint64_t limit);
+void jit_invalidate(gb_jit_t *jit);
+void jit_reset(gb_jit_t *jit);
+
+#endif
@@ -0,0 +1,39 @@
+#include "joypad.h"
+
+/* the input lines P1 shows for the selected groups, set while a button is held */
+static uint8_t _lines(gb_joypad_t *joypad) {
+	uint8_t lines = 0;
+	if (!(joypad->select & 0x10))
+		lines |= joypad->buttons >> 4;
+	if (!(joypad->select & 0x20))
+		lines |= joypad->buttons & 0x0f;
+	return lines;
+}
+
+/* any line going low raises the interrupt, whether from a press or from selecting another group */
+static void _update(gb_joypad_t *joypad, uint8_t lines) {
+	if (_lines(joypad) & ~lines)
+		joypad->interrupts |= INTERRUPT_JOYPAD;
+}
+
+void init_joypad(gb_joypad_t *joypad) {
+	joypad->buttons = 0;
+	joypad->select = 0x30;
+	joypad->interrupts = 0;
+}
+
+uint8_t joypad_read(gb_joypad_t *joypad) {
+	return 0xc0 | joypad->select | (~_lines(joypad) & 0x0f);
+}
+
+void joypad_write(gb_joypad_t *joypad, uint8_t value) {
+	uint8_t lines = _lines(joypad);
+	joypad->select = value & 0x30;
+	_update(joypad, lines);
+}
+
+void joypad_set(gb_joypad_t *joypad, uint8_t buttons) {
+	uint8_t lines = _lines(joypad);
+	joypad->buttons = buttons;
+	_update(joypad, lines);
+}
@@ -0,0 +1,30 @@
+#ifndef joypad_h
+#define joypad_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define INTERRUPT_JOYPAD 0x10
+
+/* pressed buttons are set bits, actions in the low nibble and directions in the high one like P1 */
+#define BUTTON_A 0x01
+#define BUTTON_B 0x02
+#define BUTTON_SELECT 0x04
+#define BUTTON_START 0x08
+#define BUTTON_RIGHT 0x10
+#define BUTTON_LEFT 0x20
+#define BUTTON_UP 0x40
+#define BUTTON_DOWN 0x80
+
+typedef struct {
+	uint8_t buttons;
+	uint8_t select;
+	uint8_t interrupts;
+} gb_joypad_t;
+
+void init_joypad(gb_joypad_t *joypad);
+uint8_t joypad_read(gb_joypad_t *joypad);
+void joypad_write(gb_joypad_t *joypad, uint8_t value);
+void joypad_set(gb_joypad_t *joypad, uint8_t buttons);
+
+#endif
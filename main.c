@@ -1,49 +1,210 @@
 #include <stdio.h>
 #include <stdbool.h>
-#include <process.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
+#ifndef GB_HEADLESS
 #include <SDL2/SDL.h>
+#endif
 #include "rom.h"
 #include "ppu.h"
+#include "cart.h"
 #include "cpu.h"
+#include "jit.h"
+#include "savestate.h"
+#include "rewind.h"
+#include "movie.h"
 #include "utils.h"
 
-#define SCREEN_WIDTH 480
-#define SCREEN_HEIGHT 432
+#define SCREEN_SCALE 3
+#define QUICK_STATE "quick.state"
+
+#ifndef GB_HEADLESS
+static SDL_Window *main_window = NULL;
+
+/* one upload per frame into a streaming texture, the renderer does the scaling */
+static void present_frame(SDL_Renderer *renderer, SDL_Texture *texture, gb_ppu_t *ppu) {
+	void *pixels;
+	int pitch;
+	if (SDL_LockTexture(texture, NULL, &pixels, &pitch) == 0) {
+		for (int y = 0; y < LCD_HEIGHT; y++)
+			memcpy((uint8_t *)pixels + y * pitch, ppu->pixels[y], sizeof(ppu->pixels[y]));
+		SDL_UnlockTexture(texture);
+	}
+	SDL_RenderClear(renderer);
+	SDL_RenderCopy(renderer, texture, NULL, NULL);
+	SDL_RenderPresent(renderer);
+}
+
+/* arrows for the d-pad, z and x for a and b, enter for start and right shift for select */
+static uint8_t read_buttons(void) {
+	const uint8_t *keys = SDL_GetKeyboardState(NULL);
+	uint8_t buttons = 0;
+	if (keys[SDL_SCANCODE_Z])
+		buttons |= BUTTON_A;
+	if (keys[SDL_SCANCODE_X])
+		buttons |= BUTTON_B;
+	if (keys[SDL_SCANCODE_RSHIFT])
+		buttons |= BUTTON_SELECT;
+	if (keys[SDL_SCANCODE_RETURN])
+		buttons |= BUTTON_START;
+	if (keys[SDL_SCANCODE_RIGHT])
+		buttons |= BUTTON_RIGHT;
+	if (keys[SDL_SCANCODE_LEFT])
+		buttons |= BUTTON_LEFT;
+	if (keys[SDL_SCANCODE_UP])
+		buttons |= BUTTON_UP;
+	if (keys[SDL_SCANCODE_DOWN])
+		buttons |= BUTTON_DOWN;
+	return buttons;
+}
+
+/* waits out the rest of the frame at the real machine's 59.7 Hz, a late frame starts the count again instead of rushing to catch up */
+static void pace_frame(uint64_t *deadline, uint64_t period) {
+	*deadline += period;
+	uint64_t now = SDL_GetPerformanceCounter();
+	if (now >= *deadline) {
+		*deadline = now;
+		return;
+	}
+	// sdl_delay can oversleep by a millisecond or so, the last of the wait is spun
+	uint32_t ms = (*deadline - now) * 1000 / SDL_GetPerformanceFrequency();
+	if (ms > 1)
+		SDL_Delay(ms - 1);
+	while (SDL_GetPerformanceCounter() < *deadline)
+		;
+}
+#endif
+
+static void show_error(const char *message) {
+#ifndef GB_HEADLESS
+	if (main_window) {
+		SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", message, main_window);
+		return;
+	}
+#endif
+	fprintf(stderr, "%s\n", message);
+}
 
 int main(int argc, char *argv[]) {
-	srand(time(NULL));
-	SDL_Init(SDL_INIT_EVERYTHING);
+	/* headless runs never touch SDL: no window, no renderer, frames stay in display.framebuffer */
+#ifdef GB_HEADLESS
+	bool headless = true;
+#else
 	static const int buildNumber = 1;
-	static const double targetDelayTime = 1000 / 60;
-	char windowTitle[50];
-	sprintf(windowTitle, "%s %i", "b0ngw4ter development build", buildNumber);
-	SDL_Window *main_window = SDL_CreateWindow(windowTitle, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 480, 432, 0);
-	if (!main_window) {
-		err("Failed to create window.\n");
+	bool headless = false;
+#endif
+	bool jit = false, jit_verify = false, trace_drop = false;
+	long max_frames = -1;
+	long rewind_seconds = 30, rewind_memory = 32, rewind_interval = 1;
+	const char *rom_path = NULL, *trace_path = NULL, *load_path = NULL, *save_path = NULL;
+	const char *record_path = NULL, *replay_path = NULL;
+	uint16_t watchpoints[MAX_WATCHPOINTS];
+	int watchpoint_count = 0;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--headless"))
+			headless = true;
+		else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+			max_frames = strtol(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--jit"))
+			jit = true;
+		else if (!strcmp(argv[i], "--jit-verify"))
+			jit = jit_verify = true;
+		else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+			trace_path = argv[++i];
+		else if (!strcmp(argv[i], "--trace-drop"))
+			trace_drop = true;
+		else if (!strcmp(argv[i], "--load-state") && i + 1 < argc)
+			load_path = argv[++i];
+		else if (!strcmp(argv[i], "--save-state") && i + 1 < argc)
+			save_path = argv[++i];
+		else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+			record_path = argv[++i];
+		else if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+			replay_path = argv[++i];
+		else if (!strcmp(argv[i], "--rewind") && i + 1 < argc)
+			rewind_seconds = strtol(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--rewind-memory") && i + 1 < argc)
+			rewind_memory = strtol(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--rewind-interval") && i + 1 < argc)
+			rewind_interval = strtol(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--watch") && i + 1 < argc && watchpoint_count < MAX_WATCHPOINTS)
+			watchpoints[watchpoint_count++] = strtol(argv[++i], NULL, 16);
+		else
+			rom_path = argv[i];
+	}
+	// replays are regression runs, nobody watches them so they go as fast as they can
+	if (replay_path)
+		headless = true;
+
+#ifndef GB_HEADLESS
+	SDL_Renderer *renderer = NULL;
+	SDL_Texture *texture = NULL;
+	if (!headless) {
+		SDL_Init(SDL_INIT_VIDEO);
+		char windowTitle[50];
+		sprintf(windowTitle, "%s %i", "b0ngw4ter development build", buildNumber);
+		main_window = SDL_CreateWindow(windowTitle, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, LCD_WIDTH * SCREEN_SCALE, LCD_HEIGHT * SCREEN_SCALE, SDL_WINDOW_RESIZABLE);
+		if (!main_window) {
+			err("Failed to create window.\n");
+			return 1;
+		}
+	}
+#endif
+
+	if (!rom_path) {
+		show_error("Usage:\nbongwater [--headless] [--frames n] [--jit | --jit-verify] [--trace file [--trace-drop]] [--watch address] [--load-state file] [--save-state file] [--record file | --replay file] [--rewind seconds] [--rewind-memory mib] [--rewind-interval frames] <rom file>");
 		return 1;
 	}
 
-	if (argc != 2) {
-		SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", "Usage:\nbongwater <rom file>", main_window);
+	gb_mapping_t rom;
+	if (!map_file(&rom, rom_path, ROM_BANK_SIZE) || rom.file_size < 0x150) {
+		show_error("Failed to open rom file.");
 		return 1;
 	}
 
-	FILE *rom = fopen(argv[1], "rb");
-	if (!rom) {
-		SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", "Failed to open rom file.", main_window);
+	const struct rom_header *header = (const struct rom_header *)(rom.data + 0x100);
+	uint32_t rom_size = 0;
+	if (header->rom_size <= 0x8)
+		rom_size = 32768 << header->rom_size;
+	else if (header->rom_size == 0x52)
+		rom_size = 72 * 16384;
+	else if (header->rom_size == 0x53)
+		rom_size = 80 * 16384;
+	else
+		rom_size = 96 * 16384;
+
+	printf("rom_size: 0x%x\n", rom_size);
+	if (rom.file_size < rom_size)
+		err("Rom image is smaller than its header says, missing banks mirror the present ones.\n");
+
+	gb_cart_t cart;
+	if (!init_cart(&cart, rom.data, rom.size)) {
+		show_error("Unsupported cartridge.");
 		return 1;
 	}
 
 	gb_cpu_t cpu;
 	gb_ppu_t display;
-	init_cpu(&cpu, &display);
+	init_ppu(&display);
+	init_cpu(&cpu, &display, &cart);
 
-	//cpu.display->renderer = 
-	SDL_Renderer *renderer = SDL_CreateRenderer(main_window, 0, 0);
-	display.renderer = renderer;
-	struct rom_header *header = read_bytes(rom, 0x100, sizeof(struct rom_header));
+#ifndef GB_HEADLESS
+	if (!headless) {
+		// no vsync, fast-forward has to be free to run faster than the display, pace_frame keeps normal speed
+		renderer = SDL_CreateRenderer(main_window, -1, SDL_RENDERER_ACCELERATED);
+		if (!renderer)
+			renderer = SDL_CreateRenderer(main_window, -1, 0);
+		SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+		texture = renderer ? SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, LCD_WIDTH, LCD_HEIGHT) : NULL;
+		if (!texture) {
+			show_error("Failed to create renderer.");
+			return 1;
+		}
+		// keeps the aspect ratio when the window is resized, letterboxing the rest
+		SDL_RenderSetLogicalSize(renderer, LCD_WIDTH, LCD_HEIGHT);
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+	}
+#endif
 
 	if (header->old_license_code == 0x33) {
 		if (header->sgb_flag == 0x03)
@@ -52,68 +213,157 @@ int main(int argc, char *argv[]) {
 			cpu.run_mode = 1;
 	}
 
-	uint32_t rom_size = 0;
-	if (header->rom_size <= 0x8)
-		rom_size = 32768 << header->rom_size;
-	else if (header->rom_size == 0x52)
-		rom_size = 72 * 32768;
-	else if (header->rom_size == 0x53)
-		rom_size = 80 * 32768;
-	else
-		rom_size = 96 * 32768;
-		
-	free(header);
-
-	printf("rom_size: 0x%x\n", rom_size);
-	fread(cpu.addressSpace, rom_size, 1, rom);
+	gb_mapping_t bootloader;
+	if (!map_file(&bootloader, "bootloader.bin", 1) || bootloader.file_size < 0x100) {
+		show_error("Failed to open bootloader.bin.");
+		return 1;
+	}
+	cpu.boot_rom = bootloader.data;
+	cpu.boot_mapped = 1;
+	mmu_map_boot(&cpu);
+	if (load_path && !load_state_file(&cpu, load_path))
+		err("Failed to load state.\n");
 
-	FILE *bootloader = fopen("bootloader.bin", "rb");
-	fread(cpu.addressSpace, 256, 1, bootloader);
+	/* movies start from power on, so they can't be combined with a loaded state or with rewinding */
+	gb_movie_t *movie = NULL;
+	if (record_path || replay_path) {
+		if (load_path || (record_path && replay_path)) {
+			show_error("A movie can't be combined with --load-state or another movie.");
+			return 1;
+		}
+		movie = record_path ? record_movie(&cpu, record_path) : replay_movie(&cpu, replay_path);
+		if (!movie) {
+			show_error("Failed to open movie file.");
+			return 1;
+		}
+		rewind_seconds = 0;
+	}
 
 	bool running = true;
-	FILE *dump = fopen("dump.txt", "w+");
-	char x[] = "bcdehlza";
+	long frame = 0;
+	// run_until stops on the first instruction past its target, so a loaded state goes back to its frame boundary
+	uint64_t frame_end = cpu.scheduler.now - cpu.scheduler.now % CYCLES_PER_FRAME;
+	if (jit)
+		cpu.jit = init_jit(&cpu, jit_verify);
+	/* always on, flight.bin is opened now but only filled on an illegal opcode, a watchpoint or a crash */
+	cpu.recorder = open_flight_recorder("flight.bin");
+	// like the trace it sees interpreted blocks only, native ones never reach flight_record
+	if (cpu.jit && cpu.recorder)
+		err("The flight recorder misses blocks run by the jit.\n");
+	for (int i = 0; i < watchpoint_count; i++)
+		add_watchpoint(&cpu, watchpoints[i]);
+	/* the trace only covers interpreted code, so it is off while the jit runs */
+	if (trace_path) {
+		if (cpu.jit)
+			err("Tracing is not supported with the jit.\n");
+		else if (!(cpu.trace = open_trace(trace_path, trace_drop)))
+			err("Failed to open trace file.\n");
+	}
+	/* only windowed runs rewind, headless ones have no key to hold */
+	gb_rewind_t *rewind = NULL;
+	long rewind_countdown = 0;
+	if (!headless && rewind_seconds > 0) {
+		if (rewind_interval < 1)
+			rewind_interval = 1;
+		if (!(rewind = init_rewind(&cpu, (size_t)rewind_memory << 20, rewind_seconds * 60 / rewind_interval)))
+			err("Failed to allocate the rewind buffer.\n");
+	}
+#ifndef GB_HEADLESS
+	uint64_t frame_period = 0, frame_deadline = 0;
+	if (!headless) {
+		frame_period = SDL_GetPerformanceFrequency() * CYCLES_PER_FRAME / CYCLES_PER_SECOND;
+		frame_deadline = SDL_GetPerformanceCounter();
+	}
+#endif
 	while (running) {
+#ifndef GB_HEADLESS
 		SDL_Event e;
-		while (SDL_PollEvent(&e)) {
+		while (!headless && SDL_PollEvent(&e)) {
 			if (e.type == SDL_QUIT) {
 				running = false;
+			} else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F5) {
+				if (!save_state_file(&cpu, QUICK_STATE))
+					err("Failed to save state.\n");
+			} else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F8) {
+				// a load in the middle of a movie would break its replay, like --load-state does
+				if (movie)
+					err("States can't be loaded while a movie is running.\n");
+				else if (load_state_file(&cpu, QUICK_STATE))
+					frame_end = cpu.scheduler.now - cpu.scheduler.now % CYCLES_PER_FRAME;
+				else
+					err("Failed to load state.\n");
 			}
 		}
+#endif
 
-		if (cpu.pc > rom_size)
+		if (max_frames >= 0 && frame++ >= max_frames)
+			break;
+		if (movie && movie_finished(movie))
 			break;
 		
-		for (int i = 0; i < 70224; i++) {
-			if (cpu.instruction_wait_cycles == 0) {
-				//printf("pc: 0x%04x ", cpu.pc);
-				uint32_t instruction = fetch_opcode(&cpu);
-				//printf("sp: 0x%04x, inst: 0x%08x, af: 0x%04x, bc: 0x%04x, de: 0x%04x, hl: 0x%04x\n", cpu.sp, instruction, *cpu.af, *cpu.bc, *cpu.de, *cpu.hl);
-				fprintf(dump, "instruction: 0x%x, pc: 0x%x, sp:0x%x\n", instruction, cpu.pc, cpu.sp);
-				for (int i = 0; i < 8; i++) {
-					if (i != 7)
-						fprintf(dump, "%c: 0x%x, ", x[i], *cpu.registers[i]);
-					else
-						fprintf(dump, "f, 0x%x, hl: 0x%x, af: 0x%x, bc: 0x%x, de: 0x%x ", cpu.f, *cpu.hl, *cpu.af, *cpu.bc, *cpu.de);
-				}
-				fprintf(dump, "\n\n");
-				execute_instruction(&cpu, instruction);
+		bool rewinding = false;
+#ifndef GB_HEADLESS
+		rewinding = rewind && SDL_GetKeyboardState(NULL)[SDL_SCANCODE_BACKSPACE];
+#endif
+		if (rewinding) {
+			// holding backspace steps back a capture per frame, the oldest one stays on screen
+			if (rewind_step(rewind, &cpu))
+				frame_end = cpu.scheduler.now - cpu.scheduler.now % CYCLES_PER_FRAME;
+		} else {
+			uint8_t buttons = 0;
+#ifndef GB_HEADLESS
+			if (!headless)
+				buttons = read_buttons();
+#endif
+			if (movie)
+				buttons = movie_frame(movie, buttons);
+			set_buttons(&cpu, buttons);
+			frame_end += CYCLES_PER_FRAME;
+			run_until(&cpu, frame_end);
+			if (rewind && --rewind_countdown <= 0) {
+				rewind_capture(rewind, &cpu);
+				rewind_countdown = rewind_interval;
 			}
-			cpu.instruction_wait_cycles--;
 		}
-		/*
-		rect.x++;
-		rect.y = 3;
-		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-		SDL_RenderClear(renderer);
-		SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-		SDL_RenderFillRect(renderer, &rect);
-		SDL_RenderPresent(renderer);
-		SDL_Delay(targetDelayTime);*/
-	}
-	fclose(dump);
-	SDL_DestroyRenderer(renderer);
-	SDL_DestroyWindow(main_window);
-	SDL_Quit();
+		// headless runs keep the indexed framebuffer and skip the rgba expansion
+#ifndef GB_HEADLESS
+		if (!headless) {
+			drawDisplay(&display);
+			present_frame(renderer, texture, &display);
+			// holding tab fast-forwards, rewinding is paced like play so the history lasts as long as it took
+			if (SDL_GetKeyboardState(NULL)[SDL_SCANCODE_TAB])
+				frame_deadline = SDL_GetPerformanceCounter();
+			else
+				pace_frame(&frame_deadline, frame_period);
+		}
+#endif
+	}
+	if (save_path && !save_state_file(&cpu, save_path))
+		err("Failed to save state.\n");
+	if (movie) {
+		// replays double as regression runs, the hash of the final state is what to compare
+		if (!movie->recording)
+			printf("Replayed %u frames, state hash %08x.\n", movie->frame, state_hash(&cpu));
+		close_movie(movie);
+	}
+	if (cpu.trace)
+		close_trace(cpu.trace);
+	if (cpu.recorder)
+		close_flight_recorder(cpu.recorder);
+	if (rewind)
+		free_rewind(rewind);
+	if (cpu.jit)
+		free_jit(cpu.jit);
+	free_cart(&cart);
+	unmap_file(&bootloader);
+	unmap_file(&rom);
+#ifndef GB_HEADLESS
+	if (!headless) {
+		SDL_DestroyTexture(texture);
+		SDL_DestroyRenderer(renderer);
+		SDL_DestroyWindow(main_window);
+		SDL_Quit();
+	}
+#endif
 	return 0;
-}
+}
\ No newline at end of file
@@ -0,0 +1,343 @@
+#include <string.h>
+#include "cpu.h"
+#include "mmu.h"
+
+static inline uint8_t _read(gb_cpu_t *cpu, uint16_t address) {
+	const uint8_t *page = cpu->mmu.read[address >> MMU_PAGE_SHIFT];
+	if (page)
+		return page[address & (MMU_PAGE_SIZE - 1)];
+	return cpu->mmu.read_handler[address >> MMU_PAGE_SHIFT](cpu, address);
+}
+
+static uint8_t _read_open_bus(gb_cpu_t *cpu, uint16_t address) {
+	return 0xff;
+}
+
+static void _write_ignored(gb_cpu_t *cpu, uint16_t address, uint8_t value) {}
+
+static int _dirty_page(gb_cpu_t *cpu, const uint8_t *memory);
+
+/* only reached while a page holds decoded code, is watched, or is clean while tracking */
+static void _write_code(gb_cpu_t *cpu, uint16_t address, uint8_t value) {
+	uint8_t *memory = cpu->mmu.memory[address >> MMU_PAGE_SHIFT];
+	invalidate_code(cpu, address);
+	if (cpu->mmu.tracking) {
+		int index = _dirty_page(cpu, memory);
+		if (index >= 0 && !cpu->mmu.dirty[index])
+			mmu_mark_dirty(cpu, index);
+	}
+	memory[address & (MMU_PAGE_SIZE - 1)] = value;
+}
+
+static void _map_rom(gb_cpu_t *cpu, int window);
+static void _map_ram(gb_cpu_t *cpu);
+
+static void _write_rom(gb_cpu_t *cpu, uint16_t address, uint8_t value) {
+	gb_cart_t *cart = cpu->cart;
+	const uint8_t *rom0 = cart->rom_map[0];
+	const uint8_t *romx = cart->rom_map[1];
+	uint8_t *ram = cart->ram_map;
+
+	cart_write(cart, address, value);
+	if (cart->rom_map[0] != rom0)
+		_map_rom(cpu, 0);
+	if (cart->rom_map[1] != romx)
+		_map_rom(cpu, 1);
+	if (cart->ram_map != ram)
+		_map_ram(cpu);
+	// the rest of the running block may now decode from another bank
+	cpu->block_invalidated = 1;
+}
+
+static uint8_t _read_cart_ram(gb_cpu_t *cpu, uint16_t address) {
+	return cart_read_ram(cpu->cart, address);
+}
+
+static void _write_cart_ram(gb_cpu_t *cpu, uint16_t address, uint8_t value) {
+	invalidate_code(cpu, address);
+	// with the ram unmapped only the mbc2 nibbles reach memory
+	if (cpu->mmu.tracking && cpu->cart->mbc == MBC_2)
+		cpu->mmu.dirty[DIRTY_CART_RAM + ((address & (MBC2_RAM_SIZE - 1)) >> MMU_PAGE_SHIFT)] = 1;
+	cart_write(cpu->cart, address, value);
+}
+
+/* tile data has no direct write pointer to protect, so code run from it is caught here instead */
+static void _write_tiles(gb_cpu_t *cpu, uint16_t address, uint8_t value) {
+	if (cpu->code_lines[address >> CODE_LINE_SHIFT])
+		invalidate_code(cpu, address);
+	if (cpu->mmu.tracking)
+		cpu->mmu.dirty[DIRTY_VRAM + ((address - 0x8000) >> MMU_PAGE_SHIFT)] = 1;
+	ppu_write_vram(cpu->ppu, address, value);
+}
+
+static uint8_t _read_oam(gb_cpu_t *cpu, uint16_t address) {
+	// FEA0-FEFF is not connected to anything
+	if (address >= 0xfea0)
+		return 0;
+	return cpu->ppu->oam[address - 0xfe00];
+}
+
+static void _write_oam(gb_cpu_t *cpu, uint16_t address, uint8_t value) {
+	if (address < 0xfea0)
+		cpu->ppu->oam[address - 0xfe00] = value;
+}
+
+static uint8_t _read_io(gb_cpu_t *cpu, uint16_t address) {
+	if (address >= 0xff40 && address <= 0xff4b && address != 0xff46)
+		return ppu_read(cpu->ppu, address);
+	if (address >= 0xff04 && address <= 0xff07) {
+		// div and tima move without an event, so a loop polling them must never look idle
+		if (address <= 0xff05)
+			cpu->block_invalidated = 1;
+		return timer_read(&cpu->timer, cpu->scheduler.now, address);
+	}
+	if (address == 0xff00)
+		return joypad_read(&cpu->joypad);
+	if (address == 0xff0f)
+		return cpu->addressSpace[address] | 0xe0;
+	return cpu->addressSpace[address];
+}
+
+static void _write_lcd(gb_cpu_t *cpu, uint16_t address, uint8_t value) {
+	gb_ppu_t *ppu = cpu->ppu;
+	uint8_t lcdc = ppu->lcdc;
+
+	ppu_write(ppu, address, value);
+	if ((lcdc ^ ppu->lcdc) & LCDC_ENABLE) {
+		if (ppu->lcdc & LCDC_ENABLE)
+			schedule_event(&cpu->scheduler, GB_EVENT_PPU, cpu->scheduler.now + PPU_OAM_CYCLES);
+		else
+			cancel_event(&cpu->scheduler, GB_EVENT_PPU);
+	}
+	if (ppu->interrupts) {
+		request_interrupts(cpu, ppu->interrupts);
+		ppu->interrupts = 0;
+	}
+}
+
+static void _write_io(gb_cpu_t *cpu, uint16_t address, uint8_t value) {
+	if (address >= 0xff40 && address <= 0xff4b && address != 0xff46) {
+		_write_lcd(cpu, address, value);
+		return;
+	}
+
+	if (address == 0xff00) {
+		joypad_write(&cpu->joypad, value);
+		if (cpu->joypad.interrupts) {
+			request_interrupts(cpu, cpu->joypad.interrupts);
+			cpu->joypad.interrupts = 0;
+		}
+		return;
+	}
+
+	if (address >= 0xff04 && address <= 0xff07) {
+		timer_write(&cpu->timer, cpu->scheduler.now, address, value);
+		update_timer(cpu);
+		return;
+	}
+
+	// a newly pending interrupt is taken after this instruction, not at the end of the block
+	if (address == 0xff0f || address == 0xffff)
+		cpu->block_invalidated = 1;
+
+	switch (address) {
+		case 0xff46:
+			for (int i = 0; i < 0xa0; i++)
+				cpu->ppu->oam[i] = _read(cpu, (value << 8) + i);
+			break;
+		case 0xff50:
+			if (value && cpu->boot_mapped) {
+				cpu->boot_mapped = 0;
+				mmu_map_boot(cpu);
+				cpu->block_invalidated = 1;
+			}
+			break;
+		default:
+			// hram is the one part of this page code runs from
+			if (address >= 0xff80)
+				invalidate_code(cpu, address);
+			break;
+	}
+	cpu->addressSpace[address] = value;
+}
+
+/* where the state page behind some memory is, or -1 for memory delta states don't track */
+static int _dirty_page(gb_cpu_t *cpu, const uint8_t *memory) {
+	const uint8_t *wram = cpu->addressSpace + 0xc000;
+	const uint8_t *vram = cpu->ppu->vram;
+	const uint8_t *ram = cpu->cart->ram;
+
+	if (memory >= wram && memory < wram + 0x2000)
+		return DIRTY_WRAM + ((memory - wram) >> MMU_PAGE_SHIFT);
+	if (memory >= vram && memory < vram + 0x2000)
+		return DIRTY_VRAM + ((memory - vram) >> MMU_PAGE_SHIFT);
+	if (ram && memory >= ram && memory < ram + cpu->cart->ram_banks * RAM_BANK_SIZE)
+		return DIRTY_CART_RAM + ((memory - ram) >> MMU_PAGE_SHIFT);
+	return -1;
+}
+
+static void _update_write(gb_cpu_t *cpu, uint8_t page) {
+	gb_mmu_t *mmu = &cpu->mmu;
+	uint8_t *memory = mmu->memory[page];
+	if (!memory)
+		return;
+
+	bool clean = 0;
+	if (mmu->tracking) {
+		int index = _dirty_page(cpu, memory);
+		clean = index >= 0 && !mmu->dirty[index];
+	}
+	mmu->write[page] = mmu->protected[page] || mmu->watched[page] || clean ? NULL : memory;
+}
+
+static void _map_memory(gb_cpu_t *cpu, uint8_t page, uint8_t *memory) {
+	gb_mmu_t *mmu = &cpu->mmu;
+	mmu->memory[page] = memory;
+	mmu->read[page] = memory;
+	mmu->write_handler[page] = _write_code;
+	_update_write(cpu, page);
+}
+
+static void _map_handlers(gb_mmu_t *mmu, uint8_t page, gb_read_handler_t read_handler, gb_write_handler_t write_handler) {
+	mmu->memory[page] = NULL;
+	mmu->read[page] = NULL;
+	mmu->write[page] = NULL;
+	mmu->read_handler[page] = read_handler;
+	mmu->write_handler[page] = write_handler;
+}
+
+void init_mmu(gb_cpu_t *cpu) {
+	gb_mmu_t *mmu = &cpu->mmu;
+	memset(mmu->protected, 0, sizeof(mmu->protected));
+	memset(mmu->watched, 0, sizeof(mmu->watched));
+	mmu->tracking = 0;
+
+	for (int page = 0; page < MMU_PAGES; page++)
+		_map_handlers(mmu, page, _read_open_bus, _write_ignored);
+	// tile data reads stay direct, writes have to mark the decoded tile stale
+	for (int page = 0x80; page < 0x98; page++) {
+		_map_handlers(mmu, page, _read_open_bus, _write_tiles);
+		mmu->read[page] = cpu->ppu->vram + ((page - 0x80) << MMU_PAGE_SHIFT);
+	}
+	for (int page = 0x98; page < 0xa0; page++)
+		_map_memory(cpu, page, cpu->ppu->vram + ((page - 0x80) << MMU_PAGE_SHIFT));
+	for (int page = 0xc0; page < 0xe0; page++)
+		_map_memory(cpu, page, cpu->addressSpace + (page << MMU_PAGE_SHIFT));
+	// echo ram aliases the first 7.5 KiB of work ram
+	for (int page = 0xe0; page < 0xfe; page++)
+		_map_memory(cpu, page, cpu->addressSpace + ((page - 0x20) << MMU_PAGE_SHIFT));
+	_map_handlers(mmu, 0xfe, _read_oam, _write_oam);
+	_map_handlers(mmu, 0xff, _read_io, _write_io);
+
+	mmu_map_cart(cpu);
+}
+
+/* page 0 shows the boot rom until FF50 is written */
+void mmu_map_boot(gb_cpu_t *cpu) {
+	cpu->mmu.read[0] = cpu->boot_mapped ? cpu->boot_rom : cpu->cart->rom_map[0];
+}
+
+/* a bank switch only repoints the pages of the window that changed, nothing is copied */
+static void _map_rom(gb_cpu_t *cpu, int window) {
+	const uint8_t *bank = cpu->cart->rom_map[window];
+	int first = window << 6;
+	for (int page = 0; page < 0x40; page++)
+		cpu->mmu.read[first + page] = bank + (page << MMU_PAGE_SHIFT);
+	if (!window)
+		mmu_map_boot(cpu);
+}
+
+static void _map_ram(gb_cpu_t *cpu) {
+	uint8_t *bank = cpu->cart->ram_map;
+	for (int page = 0xa0; page < 0xc0; page++) {
+		if (bank)
+			_map_memory(cpu, page, bank + ((page - 0xa0) << MMU_PAGE_SHIFT));
+		else
+			_map_handlers(&cpu->mmu, page, _read_cart_ram, _write_cart_ram);
+	}
+}
+
+void mmu_map_cart(gb_cpu_t *cpu) {
+	for (int page = 0; page < 0x80; page++)
+		_map_handlers(&cpu->mmu, page, _read_open_bus, _write_rom);
+	_map_rom(cpu, 0);
+	_map_rom(cpu, 1);
+	_map_ram(cpu);
+}
+
+static inline int _mirror(uint8_t page) {
+	if (page >= 0xc0 && page < 0xde)
+		return page + 0x20;
+	if (page >= 0xe0 && page < 0xfe)
+		return page - 0x20;
+	return -1;
+}
+
+static void _set_protected(gb_cpu_t *cpu, uint8_t page, bool protected) {
+	cpu->mmu.protected[page] = protected;
+	_update_write(cpu, page);
+}
+
+/* sends writes to a page holding decoded code through _write_code so the block cache sees them */
+void mmu_protect(gb_cpu_t *cpu, uint8_t page) {
+	int mirror = _mirror(page);
+	_set_protected(cpu, page, 1);
+	if (mirror >= 0)
+		_set_protected(cpu, mirror, 1);
+}
+
+/* lifts the protection again once neither the page nor its echo holds code */
+void mmu_unprotect(gb_cpu_t *cpu, uint8_t page) {
+	int mirror = _mirror(page);
+	int lines = 1 << (MMU_PAGE_SHIFT - CODE_LINE_SHIFT);
+	for (int i = 0; i < lines; i++) {
+		if (cpu->code_lines[page * lines + i])
+			return;
+		if (mirror >= 0 && cpu->code_lines[mirror * lines + i])
+			return;
+	}
+	_set_protected(cpu, page, 0);
+	if (mirror >= 0)
+		_set_protected(cpu, mirror, 0);
+}
+
+/* keeps writes to the page on the slow path where check_watchpoints sees them */
+void mmu_watch(gb_cpu_t *cpu, uint8_t page) {
+	cpu->mmu.watched[page] = 1;
+	cpu->mmu.write[page] = NULL;
+}
+
+int mmu_tracked_pages(gb_cpu_t *cpu) {
+	return DIRTY_CART_RAM + (cpu->cart->ram ? cpu->cart->ram_banks * RAM_BANK_SIZE / MMU_PAGE_SIZE : 0);
+}
+
+uint8_t *mmu_tracked_memory(gb_cpu_t *cpu, int index) {
+	if (index >= DIRTY_CART_RAM)
+		return cpu->cart->ram + ((index - DIRTY_CART_RAM) << MMU_PAGE_SHIFT);
+	if (index >= DIRTY_VRAM)
+		return cpu->ppu->vram + ((index - DIRTY_VRAM) << MMU_PAGE_SHIFT);
+	return cpu->addressSpace + 0xc000 + ((index - DIRTY_WRAM) << MMU_PAGE_SHIFT);
+}
+
+/* starts copy-on-write tracking with every page clean, or every page already dirty */
+void mmu_track(gb_cpu_t *cpu, bool dirty) {
+	cpu->mmu.tracking = 1;
+	memset(cpu->mmu.dirty, dirty, sizeof(cpu->mmu.dirty));
+	for (int page = 0; page < MMU_PAGES; page++)
+		_update_write(cpu, page);
+}
+
+void mmu_untrack(gb_cpu_t *cpu) {
+	cpu->mmu.tracking = 0;
+	for (int page = 0; page < MMU_PAGES; page++)
+		_update_write(cpu, page);
+}
+
+/* gives back the direct write pointer of every page showing this memory, echo ram included */
+void mmu_mark_dirty(gb_cpu_t *cpu, int index) {
+	cpu->mmu.dirty[index] = 1;
+	for (int page = 0; page < MMU_PAGES; page++) {
+		if (cpu->mmu.memory[page] && _dirty_page(cpu, cpu->mmu.memory[page]) == index)
+			_update_write(cpu, page);
+	}
+}
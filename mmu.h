@@ -0,0 +1,52 @@
+#ifndef mmu_h
+#define mmu_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MMU_PAGE_SHIFT 8
+#define MMU_PAGE_SIZE (1 << MMU_PAGE_SHIFT)
+#define MMU_PAGES (0x10000 >> MMU_PAGE_SHIFT)
+
+/* delta states track writes per page of work ram, vram and cart ram, numbered in that order */
+#define DIRTY_WRAM 0
+#define DIRTY_VRAM 0x20
+#define DIRTY_CART_RAM 0x40
+#define DIRTY_PAGES (DIRTY_CART_RAM + 0x20000 / MMU_PAGE_SIZE)
+
+struct gb_cpu;
+
+typedef uint8_t (*gb_read_handler_t)(struct gb_cpu *cpu, uint16_t address);
+typedef void (*gb_write_handler_t)(struct gb_cpu *cpu, uint16_t address, uint8_t value);
+
+/*
+ * one entry per 256 byte page. plain memory pages have a direct pointer and never leave the
+ * fast path, a NULL pointer sends the access to the page's handler instead
+ */
+typedef struct {
+	const uint8_t *read[MMU_PAGES];
+	uint8_t *write[MMU_PAGES];
+	uint8_t *memory[MMU_PAGES];
+	gb_read_handler_t read_handler[MMU_PAGES];
+	gb_write_handler_t write_handler[MMU_PAGES];
+	bool protected[MMU_PAGES];
+	bool watched[MMU_PAGES];
+
+	/* while tracking, clean pages have no direct write pointer so their first write is seen */
+	bool tracking;
+	bool dirty[DIRTY_PAGES];
+} gb_mmu_t;
+
+void init_mmu(struct gb_cpu *cpu);
+void mmu_map_boot(struct gb_cpu *cpu);
+void mmu_map_cart(struct gb_cpu *cpu);
+void mmu_protect(struct gb_cpu *cpu, uint8_t page);
+void mmu_unprotect(struct gb_cpu *cpu, uint8_t page);
+void mmu_watch(struct gb_cpu *cpu, uint8_t page);
+int mmu_tracked_pages(struct gb_cpu *cpu);
+uint8_t *mmu_tracked_memory(struct gb_cpu *cpu, int index);
+void mmu_track(struct gb_cpu *cpu, bool dirty);
+void mmu_untrack(struct gb_cpu *cpu);
+void mmu_mark_dirty(struct gb_cpu *cpu, int index);
+
+#endif
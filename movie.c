@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <string.h>
+#include "movie.h"
+#include "rom.h"
+
+static uint16_t _rom_checksum(gb_cpu_t *cpu) {
+	return ((const struct rom_header *)(cpu->cart->rom + 0x100))->rom_checksum;
+}
+
+/* records are packed, five bytes each */
+static bool _write_record(FILE *file, uint32_t frame, uint8_t buttons) {
+	return fwrite(&frame, sizeof(frame), 1, file) == 1 && fwrite(&buttons, 1, 1, file) == 1;
+}
+
+static bool _read_record(FILE *file, gb_movie_record_t *record) {
+	return fread(&record->frame, sizeof(record->frame), 1, file) == 1 && fread(&record->buttons, 1, 1, file) == 1;
+}
+
+static gb_movie_t *_open(const char *path, bool recording) {
+	gb_movie_t *movie = calloc(1, sizeof(gb_movie_t));
+	if (!movie)
+		return NULL;
+	movie->file = fopen(path, recording ? "wb" : "rb");
+	if (!movie->file) {
+		free(movie);
+		return NULL;
+	}
+	movie->recording = recording;
+	return movie;
+}
+
+gb_movie_t *record_movie(gb_cpu_t *cpu, const char *path) {
+	gb_movie_t *movie = _open(path, 1);
+	if (!movie)
+		return NULL;
+	// the frame count is filled in by close_movie
+	gb_movie_header_t header = {MOVIE_MAGIC, MOVIE_VERSION, _rom_checksum(cpu), 0};
+	if (fwrite(&header, sizeof(header), 1, movie->file) != 1) {
+		close_movie(movie);
+		return NULL;
+	}
+	return movie;
+}
+
+gb_movie_t *replay_movie(gb_cpu_t *cpu, const char *path) {
+	gb_movie_t *movie = _open(path, 0);
+	if (!movie)
+		return NULL;
+	gb_movie_header_t header;
+	if (fread(&header, sizeof(header), 1, movie->file) != 1 || memcmp(header.magic, MOVIE_MAGIC, 4) ||
+		header.version != MOVIE_VERSION || header.rom_checksum != _rom_checksum(cpu)) {
+		close_movie(movie);
+		return NULL;
+	}
+	movie->frames = header.frames;
+	movie->pending = _read_record(movie->file, &movie->next);
+	return movie;
+}
+
+void close_movie(gb_movie_t *movie) {
+	if (movie->recording) {
+		fseek(movie->file, offsetof(gb_movie_header_t, frames), SEEK_SET);
+		fwrite(&movie->frame, sizeof(movie->frame), 1, movie->file);
+	}
+	fclose(movie->file);
+	free(movie);
+}
+
+/*
+ * called once before each frame runs. recording logs the buttons when they changed and passes them
+ * through, replaying ignores them and returns what was held on this frame of the recording
+ */
+uint8_t movie_frame(gb_movie_t *movie, uint8_t buttons) {
+	uint32_t frame = movie->frame++;
+	if (movie->recording) {
+		if (buttons != movie->buttons && !_write_record(movie->file, frame, buttons))
+			fprintf(stderr, "Failed to write movie.\n");
+		movie->buttons = buttons;
+		return buttons;
+	}
+
+	while (movie->pending && movie->next.frame <= frame) {
+		movie->buttons = movie->next.buttons;
+		movie->pending = _read_record(movie->file, &movie->next);
+	}
+	return movie->buttons;
+}
+
+bool movie_finished(gb_movie_t *movie) {
+	return !movie->recording && movie->frame >= movie->frames;
+}
@@ -0,0 +1,45 @@
+#ifndef movie_h
+#define movie_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+
+#define MOVIE_MAGIC "GBMV"
+#define MOVIE_VERSION 1
+
+/*
+ * input recorded from power on. the header is followed by one record per change of the held
+ * buttons, each the frame it takes effect on and the new buttons. input only ever changes between
+ * frames and nothing else in the machine depends on the host, so replaying is bit exact
+ */
+typedef struct {
+	char magic[4];
+	uint16_t version;
+	uint16_t rom_checksum;
+	uint32_t frames;
+} gb_movie_header_t;
+
+typedef struct {
+	uint32_t frame;
+	uint8_t buttons;
+} gb_movie_record_t;
+
+typedef struct {
+	FILE *file;
+	bool recording;
+	uint32_t frame;
+	uint32_t frames;
+	uint8_t buttons;
+	bool pending;
+	gb_movie_record_t next;
+} gb_movie_t;
+
+gb_movie_t *record_movie(gb_cpu_t *cpu, const char *path);
+gb_movie_t *replay_movie(gb_cpu_t *cpu, const char *path);
+void close_movie(gb_movie_t *movie);
+uint8_t movie_frame(gb_movie_t *movie, uint8_t buttons);
+bool movie_finished(gb_movie_t *movie);
+
+#endif
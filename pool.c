@@ -0,0 +1,204 @@
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "pool.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/*
+ * one per worker. the owner takes tasks from the bottom and idle workers steal from the top, the
+ * usual chase-lev deque except that every task is dealt out before the threads start, so it never
+ * grows and the task array is only ever read once running
+ */
+typedef struct {
+	_Alignas(64) atomic_llong top;
+	_Alignas(64) atomic_llong bottom;
+	size_t *tasks;
+	uint32_t seed;
+} gb_deque_t;
+
+typedef struct {
+	gb_deque_t *deques;
+	int workers;
+	gb_task_t task;
+	void *context;
+} gb_pool_t;
+
+typedef struct {
+	gb_pool_t *pool;
+	int worker;
+} gb_worker_t;
+
+enum { TAKE_EMPTY, TAKE_OK, TAKE_RETRY };
+
+static int _take(gb_deque_t *deque, size_t *task) {
+	long long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	long long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+	int result = TAKE_EMPTY;
+	if (top <= bottom) {
+		*task = deque->tasks[bottom];
+		result = TAKE_OK;
+		if (top < bottom)
+			return result;
+		// the last task, a thief may be after it too
+		if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+			result = TAKE_EMPTY;
+	}
+	atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+	return result;
+}
+
+static int _steal(gb_deque_t *deque, size_t *task) {
+	long long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	long long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+	if (top >= bottom)
+		return TAKE_EMPTY;
+	*task = deque->tasks[top];
+	if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+		return TAKE_RETRY;
+	return TAKE_OK;
+}
+
+/* victims are picked from a random start so idle workers don't all pile onto the same deque */
+static bool _steal_any(gb_pool_t *pool, int worker, size_t *task) {
+	gb_deque_t *own = &pool->deques[worker];
+	for (;;) {
+		own->seed ^= own->seed << 13;
+		own->seed ^= own->seed >> 17;
+		own->seed ^= own->seed << 5;
+		int start = own->seed % pool->workers;
+		bool contended = 0;
+		for (int i = 0; i < pool->workers; i++) {
+			int victim = (start + i) % pool->workers;
+			if (victim == worker)
+				continue;
+			int result = _steal(&pool->deques[victim], task);
+			if (result == TAKE_OK)
+				return 1;
+			contended |= result == TAKE_RETRY;
+		}
+		// nothing is added once running, so a sweep that found every deque empty means it's all taken
+		if (!contended)
+			return 0;
+	}
+}
+
+static void _work(gb_worker_t *worker) {
+	gb_pool_t *pool = worker->pool;
+	size_t task;
+	for (;;) {
+		if (_take(&pool->deques[worker->worker], &task) != TAKE_OK && !_steal_any(pool, worker->worker, &task))
+			break;
+		pool->task(pool->context, task, worker->worker);
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI _thread(LPVOID worker) {
+	_work(worker);
+	return 0;
+}
+#else
+static void *_thread(void *worker) {
+	_work(worker);
+	return NULL;
+}
+#endif
+
+static void _free_deques(gb_deque_t *deques) {
+#ifdef _WIN32
+	_aligned_free(deques);
+#else
+	free(deques);
+#endif
+}
+
+int pool_default_workers(void) {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	int count = info.dwNumberOfProcessors;
+#else
+	int count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return count > 0 ? count : 1;
+}
+
+bool run_pool(int workers, size_t count, gb_task_t task, void *context) {
+	if (workers < 1)
+		workers = 1;
+	if ((size_t)workers > count)
+		workers = count ? count : 1;
+
+	// each deque's ends sit on their own cache lines, which plain malloc doesn't promise
+#ifdef _WIN32
+	gb_pool_t pool = {_aligned_malloc(workers * sizeof(gb_deque_t), 64), workers, task, context};
+#else
+	gb_pool_t pool = {aligned_alloc(64, workers * sizeof(gb_deque_t)), workers, task, context};
+#endif
+	size_t *tasks = malloc((count ? count : 1) * sizeof(size_t));
+	gb_worker_t *args = malloc(workers * sizeof(gb_worker_t));
+#ifdef _WIN32
+	HANDLE *threads = malloc(workers * sizeof(HANDLE));
+#else
+	pthread_t *threads = malloc(workers * sizeof(pthread_t));
+#endif
+	if (!pool.deques || !tasks || !args || !threads) {
+		_free_deques(pool.deques);
+		free(tasks);
+		free(args);
+		free(threads);
+		return 0;
+	}
+
+	// dealt round robin, each deque gets a contiguous slice of the array with its first task at the bottom
+	size_t slice = 0;
+	for (int w = 0; w < workers; w++) {
+		gb_deque_t *deque = &pool.deques[w];
+		size_t size = count / workers + ((size_t)w < count % workers);
+		deque->tasks = tasks + slice;
+		for (size_t i = 0; i < size; i++)
+			deque->tasks[size - 1 - i] = w + i * workers;
+		slice += size;
+		atomic_init(&deque->top, 0);
+		atomic_init(&deque->bottom, size);
+		deque->seed = 2463534242u + w * 0x9e3779b9u;
+		args[w] = (gb_worker_t){&pool, w};
+	}
+
+	// a worker that fails to start just leaves its tasks to be stolen
+	int started = 1;
+#ifdef _WIN32
+	for (; started < workers; started++)
+		if (!(threads[started] = CreateThread(NULL, 0, _thread, &args[started], 0, NULL)))
+			break;
+#else
+	for (; started < workers; started++)
+		if (pthread_create(&threads[started], NULL, _thread, &args[started]))
+			break;
+#endif
+	_work(&args[0]);
+	for (int w = 1; w < started; w++) {
+#ifdef _WIN32
+		WaitForSingleObject(threads[w], INFINITE);
+		CloseHandle(threads[w]);
+#else
+		pthread_join(threads[w], NULL);
+#endif
+	}
+
+	free(threads);
+	free(args);
+	free(tasks);
+	_free_deques(pool.deques);
+	return 1;
+}
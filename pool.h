@@ -0,0 +1,15 @@
+#ifndef pool_h
+#define pool_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* runs index on one of the pool's threads, worker is which one so callers can keep per thread scratch */
+typedef void (*gb_task_t)(void *context, size_t index, int worker);
+
+int pool_default_workers(void);
+/* runs every index below count once and returns when they are all done, the caller is worker 0 */
+bool run_pool(int workers, size_t count, gb_task_t task, void *context);
+
+#endif
@@ -1,3 +1,265 @@
-void drawDisplay() {
-    
-}
\ No newline at end of file
+#include <string.h>
+#include "ppu.h"
+#include "simd.h"
+
+/* classic dmg greys, stored as r, g, b, a bytes */
+static const uint8_t _shades[4][4] = {
+    {0xff, 0xff, 0xff, 0xff},
+    {0xaa, 0xaa, 0xaa, 0xff},
+    {0x55, 0x55, 0x55, 0xff},
+    {0x00, 0x00, 0x00, 0xff}
+};
+
+void init_ppu(gb_ppu_t *ppu) {
+    memset(ppu, 0, sizeof(gb_ppu_t));
+    ppu->mode = PPU_MODE_HBLANK;
+    memset(ppu->tile_dirty, 1, sizeof(ppu->tile_dirty));
+    init_simd();
+}
+
+/* writes to the tile data area come through here so the decoded copy can be dropped */
+void ppu_write_vram(gb_ppu_t *ppu, uint16_t address, uint8_t value) {
+    uint16_t offset = address & 0x1fff;
+    ppu->vram[offset] = value;
+    if (offset < PPU_TILES * 16)
+        ppu->tile_dirty[offset >> 4] = 1;
+}
+
+static void _decode_tile(gb_ppu_t *ppu, unsigned tile) {
+    decode_tile(&ppu->vram[tile * 16], ppu->tiles[0][tile], ppu->tiles[1][tile]);
+    ppu->tile_dirty[tile] = 0;
+}
+
+static inline const uint8_t *_tile_row(gb_ppu_t *ppu, unsigned tile, int flip, int row) {
+    if (ppu->tile_dirty[tile])
+        _decode_tile(ppu, tile);
+    return ppu->tiles[flip][tile][row];
+}
+
+/* raises STAT on the rising edge of any enabled condition, like the hardware's shared interrupt line */
+static void _update_stat(gb_ppu_t *ppu) {
+    bool coincidence = ppu->ly == ppu->lyc;
+    ppu->stat = (ppu->stat & 0x78) | (coincidence << 2) | ppu->mode;
+
+    bool line = ((ppu->stat & 0x08) && ppu->mode == PPU_MODE_HBLANK) ||
+        ((ppu->stat & 0x10) && ppu->mode == PPU_MODE_VBLANK) ||
+        ((ppu->stat & 0x20) && ppu->mode == PPU_MODE_OAM) ||
+        ((ppu->stat & 0x40) && coincidence);
+    if (line && !ppu->stat_line)
+        ppu->interrupts |= INTERRUPT_STAT;
+    ppu->stat_line = line;
+}
+
+uint8_t ppu_read(gb_ppu_t *ppu, uint16_t address) {
+    switch (address) {
+        case 0xff40: return ppu->lcdc;
+        case 0xff41: return ppu->stat | 0x80;
+        case 0xff42: return ppu->scy;
+        case 0xff43: return ppu->scx;
+        case 0xff44: return ppu->ly;
+        case 0xff45: return ppu->lyc;
+        case 0xff47: return ppu->bgp;
+        case 0xff48: return ppu->obp0;
+        case 0xff49: return ppu->obp1;
+        case 0xff4a: return ppu->wy;
+        case 0xff4b: return ppu->wx;
+        default: return 0xff;
+    }
+}
+
+void ppu_write(gb_ppu_t *ppu, uint16_t address, uint8_t value) {
+    switch (address) {
+        case 0xff40:
+            if ((ppu->lcdc ^ value) & LCDC_ENABLE) {
+                // switching off parks the ppu at the top of the screen, switching on starts a new frame
+                ppu->ly = 0;
+                ppu->window_line = 0;
+                ppu->mode = value & LCDC_ENABLE ? PPU_MODE_OAM : PPU_MODE_HBLANK;
+                // an lcd that is off shows white, colour 0 through an all zero palette
+                if (!(value & LCDC_ENABLE)) {
+                    memset(ppu->framebuffer, 0, sizeof(ppu->framebuffer));
+                    memset(ppu->line_palettes, 0, sizeof(ppu->line_palettes));
+                }
+            }
+            ppu->lcdc = value;
+            break;
+        case 0xff41: ppu->stat = (ppu->stat & 0x07) | (value & 0x78); break;
+        case 0xff42: ppu->scy = value; break;
+        case 0xff43: ppu->scx = value; break;
+        case 0xff45: ppu->lyc = value; break;
+        case 0xff47: ppu->bgp = value; break;
+        case 0xff48: ppu->obp0 = value; break;
+        case 0xff49: ppu->obp1 = value; break;
+        case 0xff4a: ppu->wy = value; break;
+        case 0xff4b: ppu->wx = value; break;
+        default: return;
+    }
+    _update_stat(ppu);
+}
+
+static inline unsigned _bg_tile(gb_ppu_t *ppu, uint8_t index) {
+    // 0x8000 addressing is unsigned from tile 0, 0x8800 addressing is signed around tile 256
+    if (ppu->lcdc & LCDC_TILE_DATA)
+        return index;
+    return 256 + (int8_t)index;
+}
+
+/* draws background or window tiles from screen column start on, offset maps screen x to map x */
+static void _draw_tiles(gb_ppu_t *ppu, uint8_t *line, uint16_t map, uint8_t y, uint8_t offset, int start) {
+    const uint8_t *row = &ppu->vram[map + (y >> 3) * 32];
+    int fine = y & 7;
+
+    for (int x = start; x < LCD_WIDTH;) {
+        uint8_t mx = x + offset;
+        const uint8_t *pixels = _tile_row(ppu, _bg_tile(ppu, row[(mx >> 3) & 31]), 0, fine) + (mx & 7);
+        int count = 8 - (mx & 7);
+        if (count > LCD_WIDTH - x)
+            count = LCD_WIDTH - x;
+        memcpy(line + x, pixels, count);
+        x += count;
+    }
+}
+
+static void _draw_sprites(gb_ppu_t *ppu, uint8_t *line) {
+    int height = ppu->lcdc & LCDC_OBJ_TALL ? 16 : 8;
+    uint8_t selected[PPU_MAX_SPRITES];
+    int count = 0;
+
+    // the first ten sprites in oam order that cover this line
+    for (int i = 0; i < 40 && count < PPU_MAX_SPRITES; i++) {
+        int y = ppu->oam[i * 4] - 16;
+        if (ppu->ly >= y && ppu->ly < y + height)
+            selected[count++] = i;
+    }
+
+    // lower x wins, oam order breaks ties, so sort by x keeping oam order stable
+    for (int i = 1; i < count; i++) {
+        uint8_t sprite = selected[i];
+        int j = i;
+        for (; j > 0 && ppu->oam[selected[j - 1] * 4 + 1] > ppu->oam[sprite * 4 + 1]; j--)
+            selected[j] = selected[j - 1];
+        selected[j] = sprite;
+    }
+
+    bool drawn[LCD_WIDTH] = {0};
+    for (int i = 0; i < count; i++) {
+        const uint8_t *sprite = &ppu->oam[selected[i] * 4];
+        int x0 = sprite[1] - 8;
+        uint8_t attributes = sprite[3];
+        uint8_t tile = sprite[2];
+        int row = ppu->ly - (sprite[0] - 16);
+
+        if (attributes & 0x40)
+            row = height - 1 - row;
+        if (height == 16)
+            tile &= 0xfe;
+        if (row >= 8) {
+            tile++;
+            row -= 8;
+        }
+        const uint8_t *pixels = _tile_row(ppu, tile, (attributes & 0x20) != 0, row);
+        uint8_t palette = (attributes & 0x10 ? PALETTE_OBP1 : PALETTE_OBP0) << 2;
+
+        for (int p = 0; p < 8; p++) {
+            int x = x0 + p;
+            if (x < 0 || x >= LCD_WIDTH || drawn[x])
+                continue;
+            uint8_t colour = pixels[p];
+            if (!colour)
+                continue;
+            // an opaque sprite pixel hides lower priority sprites even when the background hides it
+            drawn[x] = 1;
+            if ((attributes & 0x80) && (line[x] & 3))
+                continue;
+            line[x] = palette | colour;
+        }
+    }
+}
+
+/* on the dmg bit 0 blanks both background and window */
+static inline bool _window_visible(gb_ppu_t *ppu) {
+    return (ppu->lcdc & LCDC_BG_ENABLE) && (ppu->lcdc & LCDC_WINDOW_ENABLE) && ppu->ly >= ppu->wy && ppu->wx < LCD_WIDTH + 7;
+}
+
+static void _render_line(gb_ppu_t *ppu) {
+    uint8_t *line = ppu->framebuffer[ppu->ly];
+
+    // the window's line counter is state, so it keeps counting even when nothing is drawn
+    if (ppu->skip_render) {
+        if (_window_visible(ppu))
+            ppu->window_line++;
+        return;
+    }
+
+    if (ppu->lcdc & LCDC_BG_ENABLE) {
+        _draw_tiles(ppu, line, ppu->lcdc & LCDC_BG_MAP ? 0x1c00 : 0x1800, ppu->scy + ppu->ly, ppu->scx, 0);
+        if (_window_visible(ppu)) {
+            int start = ppu->wx < 7 ? 0 : ppu->wx - 7;
+            _draw_tiles(ppu, line, ppu->lcdc & LCDC_WINDOW_MAP ? 0x1c00 : 0x1800, ppu->window_line, 7 - ppu->wx, start);
+            ppu->window_line++;
+        }
+    } else {
+        memset(line, 0, LCD_WIDTH);
+    }
+
+    if (ppu->lcdc & LCDC_OBJ_ENABLE)
+        _draw_sprites(ppu, line);
+
+    ppu->line_palettes[ppu->ly][PALETTE_BG] = ppu->bgp;
+    ppu->line_palettes[ppu->ly][PALETTE_OBP0] = ppu->obp0;
+    ppu->line_palettes[ppu->ly][PALETTE_OBP1] = ppu->obp1;
+}
+
+/* advances to the next mode and returns the cycles until the one after, driven by the cpu's scheduler */
+uint32_t ppu_step(gb_ppu_t *ppu) {
+    uint32_t cycles;
+
+    switch (ppu->mode) {
+        case PPU_MODE_OAM:
+            ppu->mode = PPU_MODE_DRAW;
+            cycles = PPU_DRAW_CYCLES;
+            break;
+        case PPU_MODE_DRAW:
+            _render_line(ppu);
+            ppu->mode = PPU_MODE_HBLANK;
+            cycles = PPU_HBLANK_CYCLES;
+            break;
+        case PPU_MODE_HBLANK:
+            if (++ppu->ly == LCD_HEIGHT) {
+                ppu->mode = PPU_MODE_VBLANK;
+                ppu->interrupts |= INTERRUPT_VBLANK;
+                cycles = CYCLES_PER_LINE;
+            } else {
+                ppu->mode = PPU_MODE_OAM;
+                cycles = PPU_OAM_CYCLES;
+            }
+            break;
+        default:
+            if (++ppu->ly == LINES_PER_FRAME) {
+                ppu->ly = 0;
+                ppu->window_line = 0;
+                ppu->mode = PPU_MODE_OAM;
+                cycles = PPU_OAM_CYCLES;
+            } else {
+                cycles = CYCLES_PER_LINE;
+            }
+            break;
+    }
+
+    _update_stat(ppu);
+    return cycles;
+}
+
+/* expands the indexed framebuffer to rgba through each line's palettes, only frontends need this */
+void drawDisplay(gb_ppu_t *ppu) {
+    uint32_t shades[4];
+    memcpy(shades, _shades, sizeof(shades));
+
+    for (int y = 0; y < LCD_HEIGHT; y++) {
+        uint32_t colours[12];
+        for (int palette = 0; palette < 3; palette++)
+            for (int colour = 0; colour < 4; colour++)
+                colours[palette * 4 + colour] = shades[(ppu->line_palettes[y][palette] >> (colour * 2)) & 3];
+        expand_line(ppu->framebuffer[y], colours, ppu->pixels[y], LCD_WIDTH);
+    }
+}
@@ -1,10 +1,83 @@
 #ifndef PPU_INCLUDE
 #define PPU_INCLUDE
-#include <stdio.h>
-#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LCD_WIDTH 160
+#define LCD_HEIGHT 144
+
+#define CYCLES_PER_LINE 456
+#define LINES_PER_FRAME 154
+#define CYCLES_PER_FRAME (CYCLES_PER_LINE * LINES_PER_FRAME)
+
+#define PPU_OAM_CYCLES 80
+#define PPU_DRAW_CYCLES 172
+#define PPU_HBLANK_CYCLES (CYCLES_PER_LINE - PPU_OAM_CYCLES - PPU_DRAW_CYCLES)
+#define PPU_MAX_SPRITES 10
+#define PPU_TILES 384
+
+#define LCDC_BG_ENABLE 0x01
+#define LCDC_OBJ_ENABLE 0x02
+#define LCDC_OBJ_TALL 0x04
+#define LCDC_BG_MAP 0x08
+#define LCDC_TILE_DATA 0x10
+#define LCDC_WINDOW_ENABLE 0x20
+#define LCDC_WINDOW_MAP 0x40
+#define LCDC_ENABLE 0x80
+
+#define INTERRUPT_VBLANK 0x01
+#define INTERRUPT_STAT 0x02
+
+/* framebuffer pixels are the colour index in bits 0-1 and the palette in bits 2-3 */
+#define PALETTE_BG 0
+#define PALETTE_OBP0 1
+#define PALETTE_OBP1 2
+
+typedef enum {
+    PPU_MODE_HBLANK,
+    PPU_MODE_VBLANK,
+    PPU_MODE_OAM,
+    PPU_MODE_DRAW
+} gb_ppu_mode_t;
+
 typedef struct {
     uint8_t vram[0x2000];
-    SDL_Renderer *renderer;
+    uint8_t oam[0xa0];
+
+    uint8_t lcdc;
+    uint8_t stat;
+    uint8_t scy;
+    uint8_t scx;
+    uint8_t ly;
+    uint8_t lyc;
+    uint8_t bgp;
+    uint8_t obp0;
+    uint8_t obp1;
+    uint8_t wy;
+    uint8_t wx;
+
+    gb_ppu_mode_t mode;
+    uint8_t window_line;
+    bool stat_line;
+    uint8_t interrupts;
+
+    /* set for steps in frames nobody will look at, lines are then counted but never drawn, see render_from */
+    bool skip_render;
+
+    /* everything from here on is output, palettes are captured per line so mid frame changes stick */
+    uint8_t framebuffer[LCD_HEIGHT][LCD_WIDTH];
+    uint8_t line_palettes[LCD_HEIGHT][3];
+    uint32_t pixels[LCD_HEIGHT][LCD_WIDTH];
+
+    /* tiles decoded to one byte per pixel, unflipped and x flipped, redone only after vram writes */
+    bool tile_dirty[PPU_TILES];
+    uint8_t tiles[2][PPU_TILES][8][8];
 } gb_ppu_t;
-void drawDisplay(void);
+
+void init_ppu(gb_ppu_t *ppu);
+uint8_t ppu_read(gb_ppu_t *ppu, uint16_t address);
+void ppu_write(gb_ppu_t *ppu, uint16_t address, uint8_t value);
+void ppu_write_vram(gb_ppu_t *ppu, uint16_t address, uint8_t value);
+uint32_t ppu_step(gb_ppu_t *ppu);
+void drawDisplay(gb_ppu_t *ppu);
 #endif
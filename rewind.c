@@ -0,0 +1,264 @@
+#include <stdlib.h>
+#include <string.h>
+#include "rewind.h"
+#include "savestate.h"
+
+#define MIN_MATCH 4
+
+static uint8_t *_length(uint8_t *out, size_t length) {
+	for (; length >= 255; length -= 255)
+		*out++ = 255;
+	*out++ = length;
+	return out;
+}
+
+/* lz4 style: a token with both lengths, the literals, then the match offset unless input ended */
+static uint8_t *_sequence(uint8_t *out, const uint8_t *literals, size_t literal_length, size_t offset, size_t match_length) {
+	size_t match = offset ? match_length - MIN_MATCH : 0;
+	uint8_t *token = out++;
+	*token = (literal_length < 15 ? literal_length : 15) << 4 | (match < 15 ? match : 15);
+	if (literal_length >= 15)
+		out = _length(out, literal_length - 15);
+	memcpy(out, literals, literal_length);
+	out += literal_length;
+	if (!offset)
+		return out;
+	*out++ = offset;
+	*out++ = offset >> 8;
+	if (match >= 15)
+		out = _length(out, match - 15);
+	return out;
+}
+
+/* compares a word at a time, the long zero runs are most of the work */
+static size_t _match_length(const uint8_t *ip, const uint8_t *match, const uint8_t *end) {
+	const uint8_t *start = ip;
+	while (end - ip >= 8) {
+		uint64_t a, b;
+		memcpy(&a, ip, 8);
+		memcpy(&b, match, 8);
+		if (a != b)
+			return ip - start + (__builtin_ctzll(a ^ b) >> 3);
+		ip += 8;
+		match += 8;
+	}
+	while (ip < end && *ip == *match) {
+		ip++;
+		match++;
+	}
+	return ip - start;
+}
+
+/* greedy single pass matcher, xor deltas are mostly long zero runs that match at offset 1 */
+static size_t _compress(gb_rewind_t *rewind, const uint8_t *in, size_t size, uint8_t *out) {
+	const uint8_t *ip = in, *anchor = in, *end = in + size;
+	uint8_t *start = out;
+	memset(rewind->hash, 0, sizeof(rewind->hash));
+
+	while (end - ip >= MIN_MATCH) {
+		uint32_t sequence;
+		memcpy(&sequence, ip, sizeof(sequence));
+		uint32_t hash = (sequence * 2654435761u) >> (32 - REWIND_HASH_BITS);
+		uint32_t position = ip - in + 1;
+		uint32_t reference = rewind->hash[hash];
+		rewind->hash[hash] = position;
+
+		if (!reference || position - reference > 0xffff || memcmp(in + reference - 1, ip, MIN_MATCH)) {
+			ip++;
+			continue;
+		}
+		const uint8_t *match = in + reference - 1;
+		size_t length = _match_length(ip + MIN_MATCH, match + MIN_MATCH, end) + MIN_MATCH;
+		out = _sequence(out, anchor, ip - anchor, ip - match, length);
+		ip += length;
+		anchor = ip;
+	}
+	out = _sequence(out, anchor, end - anchor, 0, 0);
+	return out - start;
+}
+
+static bool _read_length(const uint8_t **in, const uint8_t *end, size_t *length) {
+	uint8_t byte;
+	do {
+		if (*in == end)
+			return 0;
+		byte = *(*in)++;
+		*length += byte;
+	} while (byte == 255);
+	return 1;
+}
+
+static bool _decompress(const uint8_t *in, size_t size, uint8_t *out, size_t out_size) {
+	const uint8_t *end = in + size;
+	uint8_t *op = out, *out_end = out + out_size;
+
+	while (in < end) {
+		uint8_t token = *in++;
+		size_t literal_length = token >> 4;
+		if (literal_length == 15 && !_read_length(&in, end, &literal_length))
+			return 0;
+		if ((size_t)(end - in) < literal_length || (size_t)(out_end - op) < literal_length)
+			return 0;
+		memcpy(op, in, literal_length);
+		op += literal_length;
+		in += literal_length;
+		if (in == end)
+			break;
+
+		if (end - in < 2)
+			return 0;
+		size_t offset = in[0] | in[1] << 8;
+		in += 2;
+		size_t match_length = token & 15;
+		if (match_length == 15 && !_read_length(&in, end, &match_length))
+			return 0;
+		match_length += MIN_MATCH;
+		if (!offset || offset > (size_t)(op - out) || (size_t)(out_end - op) < match_length)
+			return 0;
+		// byte by byte, the match may overlap what it is writing
+		const uint8_t *match = op - offset;
+		for (size_t i = 0; i < match_length; i++)
+			op[i] = match[i];
+		op += match_length;
+	}
+	return op == out_end;
+}
+
+/* a word at a time, snapshot sizes are not a multiple of 8 so the tail goes byte by byte */
+static void _xor(uint8_t *to, const uint8_t *from, size_t size) {
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t a, b;
+		memcpy(&a, to + i, 8);
+		memcpy(&b, from + i, 8);
+		a ^= b;
+		memcpy(to + i, &a, 8);
+	}
+	for (; i < size; i++)
+		to[i] ^= from[i];
+}
+
+/* delta ends up with the xor of the two, newest with what delta held */
+static void _xor_swap(uint8_t *delta, uint8_t *newest, size_t size) {
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t a, b;
+		memcpy(&a, delta + i, 8);
+		memcpy(&b, newest + i, 8);
+		memcpy(newest + i, &a, 8);
+		a ^= b;
+		memcpy(delta + i, &a, 8);
+	}
+	for (; i < size; i++) {
+		uint8_t byte = delta[i];
+		delta[i] ^= newest[i];
+		newest[i] = byte;
+	}
+}
+
+static void _snapshot(gb_cpu_t *cpu, uint8_t *snapshot, size_t size) {
+	size_t state = save_state(cpu, snapshot, size);
+	memcpy(snapshot + state, cpu->ppu->framebuffer, sizeof(cpu->ppu->framebuffer));
+	memcpy(snapshot + state + sizeof(cpu->ppu->framebuffer), cpu->ppu->line_palettes, sizeof(cpu->ppu->line_palettes));
+}
+
+static bool _restore(gb_cpu_t *cpu, const uint8_t *snapshot, size_t size) {
+	size_t state = size - sizeof(cpu->ppu->framebuffer) - sizeof(cpu->ppu->line_palettes);
+	if (!load_state(cpu, snapshot, state))
+		return 0;
+	memcpy(cpu->ppu->framebuffer, snapshot + state, sizeof(cpu->ppu->framebuffer));
+	memcpy(cpu->ppu->line_palettes, snapshot + state + sizeof(cpu->ppu->framebuffer), sizeof(cpu->ppu->line_palettes));
+	return 1;
+}
+
+static void _drop_oldest(gb_rewind_t *rewind) {
+	rewind->first = (rewind->first + 1) % rewind->max_entries;
+	rewind->count--;
+}
+
+/* finds bound contiguous bytes at head, dropping the oldest entries until they are free */
+static void _reserve(gb_rewind_t *rewind) {
+	if (rewind->count == rewind->max_entries)
+		_drop_oldest(rewind);
+	for (;;) {
+		if (!rewind->count) {
+			rewind->head = 0;
+			return;
+		}
+		size_t tail = rewind->entries[rewind->first].offset;
+		if (rewind->head >= tail) {
+			if (rewind->capacity - rewind->head >= rewind->bound)
+				return;
+			if (tail > rewind->bound) {
+				rewind->head = 0;
+				continue;
+			}
+		} else if (tail - rewind->head > rewind->bound) {
+			return;
+		}
+		_drop_oldest(rewind);
+	}
+}
+
+/* memory is the ring size in bytes, max_entries caps how far back it goes */
+gb_rewind_t *init_rewind(gb_cpu_t *cpu, size_t memory, uint32_t max_entries) {
+	gb_rewind_t *rewind = calloc(1, sizeof(gb_rewind_t));
+	if (!rewind)
+		return NULL;
+	rewind->snapshot_size = state_size(cpu) + sizeof(cpu->ppu->framebuffer) + sizeof(cpu->ppu->line_palettes);
+	// a token and length bytes per 255 literals on top of incompressible input
+	rewind->bound = rewind->snapshot_size + rewind->snapshot_size / 255 + 16;
+	rewind->capacity = memory > 2 * rewind->bound ? memory : 2 * rewind->bound;
+	rewind->max_entries = max_entries ? max_entries : 1;
+	rewind->newest = malloc(rewind->snapshot_size);
+	rewind->scratch = malloc(rewind->snapshot_size);
+	rewind->ring = malloc(rewind->capacity);
+	rewind->entries = malloc(rewind->max_entries * sizeof(gb_rewind_entry_t));
+	if (!rewind->newest || !rewind->scratch || !rewind->ring || !rewind->entries) {
+		free_rewind(rewind);
+		return NULL;
+	}
+	// touch the ring now so the first lap around it doesn't page fault in the middle of frames
+	memset(rewind->ring, 0, rewind->capacity);
+	return rewind;
+}
+
+void free_rewind(gb_rewind_t *rewind) {
+	free(rewind->newest);
+	free(rewind->scratch);
+	free(rewind->ring);
+	free(rewind->entries);
+	free(rewind);
+}
+
+/* the same work every call, there are no periodic key frames to cause a slow one */
+void rewind_capture(gb_rewind_t *rewind, gb_cpu_t *cpu) {
+	if (!rewind->captured) {
+		_snapshot(cpu, rewind->newest, rewind->snapshot_size);
+		rewind->captured = 1;
+		return;
+	}
+
+	_snapshot(cpu, rewind->scratch, rewind->snapshot_size);
+	_xor_swap(rewind->scratch, rewind->newest, rewind->snapshot_size);
+
+	_reserve(rewind);
+	gb_rewind_entry_t *entry = &rewind->entries[(rewind->first + rewind->count++) % rewind->max_entries];
+	entry->offset = rewind->head;
+	entry->size = _compress(rewind, rewind->scratch, rewind->snapshot_size, rewind->ring + rewind->head);
+	rewind->head += entry->size;
+}
+
+/* goes back one capture, false once the oldest one is showing */
+bool rewind_step(gb_rewind_t *rewind, gb_cpu_t *cpu) {
+	if (!rewind->count)
+		return 0;
+	gb_rewind_entry_t *entry = &rewind->entries[(rewind->first + rewind->count - 1) % rewind->max_entries];
+	if (!_decompress(rewind->ring + entry->offset, entry->size, rewind->scratch, rewind->snapshot_size))
+		return 0;
+
+	_xor(rewind->newest, rewind->scratch, rewind->snapshot_size);
+	rewind->count--;
+	rewind->head = entry->offset;
+	return _restore(cpu, rewind->newest, rewind->snapshot_size);
+}
@@ -0,0 +1,46 @@
+#ifndef rewind_h
+#define rewind_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "cpu.h"
+
+#define REWIND_HASH_BITS 12
+
+typedef struct {
+	uint32_t offset;
+	uint32_t size;
+} gb_rewind_entry_t;
+
+/*
+ * the newest snapshot is kept whole, every older one only as the lz compressed xor of it and the
+ * snapshot after it, so stepping back undoes one xor at a time. a snapshot is a save state
+ * followed by the framebuffer, which the state leaves out. entries live in a byte ring and the
+ * oldest are dropped once either the memory or the entry limit is reached
+ */
+typedef struct {
+	size_t snapshot_size;
+	size_t bound;
+	bool captured;
+	uint8_t *newest;
+	uint8_t *scratch;
+
+	uint8_t *ring;
+	size_t capacity;
+	size_t head;
+
+	gb_rewind_entry_t *entries;
+	uint32_t max_entries;
+	uint32_t first;
+	uint32_t count;
+
+	uint32_t hash[1 << REWIND_HASH_BITS];
+} gb_rewind_t;
+
+gb_rewind_t *init_rewind(gb_cpu_t *cpu, size_t memory, uint32_t max_entries);
+void free_rewind(gb_rewind_t *rewind);
+void rewind_capture(gb_rewind_t *rewind, gb_cpu_t *cpu);
+bool rewind_step(gb_rewind_t *rewind, gb_cpu_t *cpu);
+
+#endif
@@ -0,0 +1,287 @@
+#include <stdlib.h>
+#include <string.h>
+#include "savestate.h"
+#include "rom.h"
+#include "utils.h"
+
+/* saving copies each field out, loading copies it back in, counting only adds up the sizes */
+typedef struct {
+	uint8_t *data;
+	size_t offset;
+	bool saving;
+} gb_state_cursor_t;
+
+static inline void _field(gb_state_cursor_t *cursor, void *field, size_t size) {
+	if (cursor->data) {
+		if (cursor->saving)
+			memcpy(cursor->data + cursor->offset, field, size);
+		else
+			memcpy(field, cursor->data + cursor->offset, size);
+	}
+	cursor->offset += size;
+}
+
+#define FIELD(cursor, field) _field(cursor, &(field), sizeof(field))
+
+/* the one list of what a state holds outside the tracked pages, shared by saving, loading and sizing */
+static void _transfer(gb_cpu_t *cpu, gb_state_cursor_t *cursor) {
+	gb_ppu_t *ppu = cpu->ppu;
+	gb_cart_t *cart = cpu->cart;
+	gb_timer_t *timer = &cpu->timer;
+
+	// f through pc are contiguous, see gb_trace_record_t
+	_field(cursor, &cpu->f, 12);
+	FIELD(cursor, cpu->halt);
+	FIELD(cursor, cpu->interrupts);
+	FIELD(cursor, cpu->ei_delay);
+	FIELD(cursor, cpu->scheduler.now);
+	FIELD(cursor, cpu->scheduler.when);
+
+	FIELD(cursor, timer->base);
+	FIELD(cursor, timer->synced);
+	FIELD(cursor, timer->tima);
+	FIELD(cursor, timer->tma);
+	FIELD(cursor, timer->tac);
+	FIELD(cursor, timer->interrupts);
+
+	FIELD(cursor, cpu->joypad.buttons);
+	FIELD(cursor, cpu->joypad.select);
+
+	// the io/hram page, work ram is a tracked page and the rest of addressSpace is never read
+	_field(cursor, cpu->addressSpace + 0xff00, 0x100);
+
+	FIELD(cursor, ppu->oam);
+	FIELD(cursor, ppu->lcdc);
+	FIELD(cursor, ppu->stat);
+	FIELD(cursor, ppu->scy);
+	FIELD(cursor, ppu->scx);
+	FIELD(cursor, ppu->ly);
+	FIELD(cursor, ppu->lyc);
+	FIELD(cursor, ppu->bgp);
+	FIELD(cursor, ppu->obp0);
+	FIELD(cursor, ppu->obp1);
+	FIELD(cursor, ppu->wy);
+	FIELD(cursor, ppu->wx);
+	FIELD(cursor, ppu->mode);
+	FIELD(cursor, ppu->window_line);
+	FIELD(cursor, ppu->stat_line);
+	FIELD(cursor, ppu->interrupts);
+
+	FIELD(cursor, cart->ram_enabled);
+	FIELD(cursor, cart->bank_low);
+	FIELD(cursor, cart->bank_high);
+	FIELD(cursor, cart->mode);
+	FIELD(cursor, cart->rtc_select);
+	FIELD(cursor, cart->rtc_latch);
+	FIELD(cursor, cart->rtc);
+	FIELD(cursor, cart->rtc_latched);
+}
+
+static size_t _scalars_size(gb_cpu_t *cpu) {
+	gb_state_cursor_t cursor = {NULL, 0, 0};
+	_transfer(cpu, &cursor);
+	return cursor.offset;
+}
+
+static uint16_t _rom_checksum(gb_cpu_t *cpu) {
+	return ((const struct rom_header *)(cpu->cart->rom + 0x100))->rom_checksum;
+}
+
+static size_t _write_header(gb_cpu_t *cpu, uint8_t *buffer, uint16_t flags, size_t size) {
+	gb_state_header_t header = {STATE_MAGIC, STATE_VERSION, flags, _rom_checksum(cpu), 0, size};
+	if (cpu->boot_mapped)
+		header.flags |= STATE_BOOT_ROM;
+	memcpy(buffer, &header, sizeof(header));
+	return sizeof(header);
+}
+
+/* checks everything a load depends on before the first field is touched */
+static bool _check_header(gb_cpu_t *cpu, const uint8_t *buffer, size_t size, gb_state_header_t *header) {
+	if (size < sizeof(*header))
+		return 0;
+	memcpy(header, buffer, sizeof(*header));
+	if (memcmp(header->magic, STATE_MAGIC, 4) || header->version != STATE_VERSION)
+		return 0;
+	if (header->size != size || header->rom_checksum != _rom_checksum(cpu))
+		return 0;
+	// a state from during boot needs the boot rom image
+	return !(header->flags & STATE_BOOT_ROM) || cpu->boot_rom;
+}
+
+/* rebuilds everything derived from the loaded fields */
+static void _restore(gb_cpu_t *cpu, uint16_t flags) {
+	load_flags(cpu);
+	for (int i = 0; i < GB_EVENT_COUNT; i++)
+		schedule_event(&cpu->scheduler, i, cpu->scheduler.when[i]);
+	cpu->boot_mapped = flags & STATE_BOOT_ROM;
+	memset(cpu->ppu->tile_dirty, 1, sizeof(cpu->ppu->tile_dirty));
+	cart_remap(cpu->cart);
+	mmu_map_cart(cpu);
+	flush_ram_code(cpu);
+}
+
+size_t state_size(gb_cpu_t *cpu) {
+	return sizeof(gb_state_header_t) + _scalars_size(cpu) + (size_t)mmu_tracked_pages(cpu) * MMU_PAGE_SIZE;
+}
+
+/* returns the number of bytes written, or 0 when the buffer is too small */
+size_t save_state(gb_cpu_t *cpu, uint8_t *buffer, size_t size) {
+	size_t needed = state_size(cpu);
+	if (size < needed)
+		return 0;
+
+	sync_flags(cpu);
+	gb_state_cursor_t cursor = {buffer, _write_header(cpu, buffer, 0, needed), 1};
+	_transfer(cpu, &cursor);
+	for (int i = 0; i < mmu_tracked_pages(cpu); i++)
+		_field(&cursor, mmu_tracked_memory(cpu, i), MMU_PAGE_SIZE);
+	return needed;
+}
+
+/* a rejected state leaves the cpu as it was */
+bool load_state(gb_cpu_t *cpu, const uint8_t *buffer, size_t size) {
+	gb_state_header_t header;
+	if (!_check_header(cpu, buffer, size, &header) || (header.flags & STATE_DELTA) || size != state_size(cpu))
+		return 0;
+
+	gb_state_cursor_t cursor = {(uint8_t *)buffer, sizeof(header), 0};
+	_transfer(cpu, &cursor);
+	for (int i = 0; i < mmu_tracked_pages(cpu); i++)
+		_field(&cursor, mmu_tracked_memory(cpu, i), MMU_PAGE_SIZE);
+	_restore(cpu, header.flags);
+	// nothing is known to match the base of a running delta any more
+	if (cpu->mmu.tracking)
+		mmu_track(cpu, 1);
+	return 1;
+}
+
+/* the state as it is now becomes the base that following deltas are taken against */
+void begin_delta(gb_cpu_t *cpu) {
+	mmu_track(cpu, 0);
+}
+
+void end_delta(gb_cpu_t *cpu) {
+	mmu_untrack(cpu);
+}
+
+/* the largest a delta can get, every tracked page changed */
+size_t delta_bound(gb_cpu_t *cpu) {
+	return sizeof(gb_state_header_t) + _scalars_size(cpu) + sizeof(uint16_t) +
+		(size_t)mmu_tracked_pages(cpu) * (sizeof(uint16_t) + MMU_PAGE_SIZE);
+}
+
+/* the scalars in full, then only the pages written since begin_delta, each behind its index */
+size_t save_delta(gb_cpu_t *cpu, uint8_t *buffer, size_t size) {
+	if (!cpu->mmu.tracking || size < delta_bound(cpu))
+		return 0;
+
+	sync_flags(cpu);
+	gb_state_cursor_t cursor = {buffer, sizeof(gb_state_header_t), 1};
+	_transfer(cpu, &cursor);
+
+	size_t count_offset = cursor.offset;
+	uint16_t count = 0;
+	cursor.offset += sizeof(count);
+	for (uint16_t i = 0; i < mmu_tracked_pages(cpu); i++) {
+		if (!cpu->mmu.dirty[i])
+			continue;
+		FIELD(&cursor, i);
+		_field(&cursor, mmu_tracked_memory(cpu, i), MMU_PAGE_SIZE);
+		count++;
+	}
+	memcpy(buffer + count_offset, &count, sizeof(count));
+	_write_header(cpu, buffer, STATE_DELTA, cursor.offset);
+	return cursor.offset;
+}
+
+/* loads base, then the delta on top. pages the delta carries stay dirty against base */
+bool load_delta(gb_cpu_t *cpu, const uint8_t *base, size_t base_size, const uint8_t *delta, size_t size) {
+	gb_state_header_t base_header, header;
+	if (!_check_header(cpu, base, base_size, &base_header) || (base_header.flags & STATE_DELTA) || base_size != state_size(cpu))
+		return 0;
+	if (!_check_header(cpu, delta, size, &header) || !(header.flags & STATE_DELTA))
+		return 0;
+
+	// the page list is walked once up front so a bad delta is rejected before anything changes
+	size_t offset = sizeof(header) + _scalars_size(cpu);
+	uint16_t count;
+	if (size < offset + sizeof(count))
+		return 0;
+	memcpy(&count, delta + offset, sizeof(count));
+	if (size != offset + sizeof(count) + count * (sizeof(uint16_t) + MMU_PAGE_SIZE))
+		return 0;
+	for (uint16_t i = 0; i < count; i++) {
+		uint16_t index;
+		memcpy(&index, delta + offset + sizeof(count) + i * (sizeof(uint16_t) + MMU_PAGE_SIZE), sizeof(index));
+		if (index >= mmu_tracked_pages(cpu))
+			return 0;
+	}
+
+	gb_state_cursor_t cursor = {(uint8_t *)base, sizeof(header) + _scalars_size(cpu), 0};
+	for (int i = 0; i < mmu_tracked_pages(cpu); i++)
+		_field(&cursor, mmu_tracked_memory(cpu, i), MMU_PAGE_SIZE);
+	cursor = (gb_state_cursor_t){(uint8_t *)delta, sizeof(header), 0};
+	_transfer(cpu, &cursor);
+
+	bool tracking = cpu->mmu.tracking;
+	if (tracking)
+		mmu_track(cpu, 0);
+	cursor.offset += sizeof(count);
+	for (uint16_t i = 0; i < count; i++) {
+		// always read, the cursor has data, but the compiler can't see through _field
+		uint16_t index = 0;
+		FIELD(&cursor, index);
+		_field(&cursor, mmu_tracked_memory(cpu, index), MMU_PAGE_SIZE);
+		if (tracking)
+			mmu_mark_dirty(cpu, index);
+	}
+	_restore(cpu, header.flags);
+	return 1;
+}
+
+/* fnv-1a over a full state, equal hashes mean the runs ended in the same place */
+uint32_t state_hash(gb_cpu_t *cpu) {
+	size_t size = state_size(cpu);
+	uint8_t *buffer = malloc(size);
+	if (!buffer)
+		return 0;
+	save_state(cpu, buffer, size);
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ buffer[i]) * 16777619u;
+	free(buffer);
+	return hash;
+}
+
+bool save_state_file(gb_cpu_t *cpu, const char *path) {
+	size_t size = state_size(cpu);
+	uint8_t *buffer = malloc(size);
+	if (!buffer)
+		return 0;
+
+	bool saved = 0;
+	FILE *file = fopen(path, "wb");
+	if (file) {
+		saved = save_state(cpu, buffer, size) && fwrite(buffer, 1, size, file) == size;
+		saved = !fclose(file) && saved;
+	}
+	free(buffer);
+	return saved;
+}
+
+bool load_state_file(gb_cpu_t *cpu, const char *path) {
+	size_t size = state_size(cpu);
+	uint8_t *buffer = malloc(size + 1);
+	if (!buffer)
+		return 0;
+
+	bool loaded = 0;
+	FILE *file = fopen(path, "rb");
+	if (file) {
+		// one byte over so a longer file is caught as the wrong size
+		loaded = load_state(cpu, buffer, fread(buffer, 1, size + 1, file));
+		fclose(file);
+	}
+	free(buffer);
+	return loaded;
+}
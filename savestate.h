@@ -0,0 +1,43 @@
+#ifndef savestate_h
+#define savestate_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "cpu.h"
+
+#define STATE_MAGIC "GBST"
+#define STATE_VERSION 3
+#define STATE_BOOT_ROM 0x0001
+#define STATE_DELTA 0x0002
+
+/*
+ * a state is this header followed by every field listed in _transfer in savestate.c, packed in
+ * that order, then the pages the mmu tracks (work ram, vram, cart ram). a delta has the same
+ * fields but only the pages written since begin_delta, each behind its uint16_t index.
+ * nothing in either is a pointer: the register aliases, the mmu tables and the block cache all
+ * point into structs that are never overwritten wholesale, so they stay valid and only the
+ * mapping they depend on is rebuilt after a load
+ */
+typedef struct {
+	char magic[4];
+	uint16_t version;
+	uint16_t flags;
+	uint16_t rom_checksum;
+	uint16_t reserved;
+	uint32_t size;
+} gb_state_header_t;
+
+size_t state_size(gb_cpu_t *cpu);
+size_t save_state(gb_cpu_t *cpu, uint8_t *buffer, size_t size);
+bool load_state(gb_cpu_t *cpu, const uint8_t *buffer, size_t size);
+void begin_delta(gb_cpu_t *cpu);
+void end_delta(gb_cpu_t *cpu);
+size_t delta_bound(gb_cpu_t *cpu);
+size_t save_delta(gb_cpu_t *cpu, uint8_t *buffer, size_t size);
+bool load_delta(gb_cpu_t *cpu, const uint8_t *base, size_t base_size, const uint8_t *delta, size_t size);
+uint32_t state_hash(gb_cpu_t *cpu);
+bool save_state_file(gb_cpu_t *cpu, const char *path);
+bool load_state_file(gb_cpu_t *cpu, const char *path);
+
+#endif
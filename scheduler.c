@@ -0,0 +1,27 @@
+#include "scheduler.h"
+
+static void _update_next(gb_scheduler_t *scheduler) {
+	uint64_t next = EVENT_NEVER;
+	for (int i = 0; i < GB_EVENT_COUNT; i++) {
+		if (scheduler->when[i] < next)
+			next = scheduler->when[i];
+	}
+	scheduler->next = next;
+}
+
+void init_scheduler(gb_scheduler_t *scheduler) {
+	scheduler->now = 0;
+	for (int i = 0; i < GB_EVENT_COUNT; i++)
+		scheduler->when[i] = EVENT_NEVER;
+	scheduler->next = EVENT_NEVER;
+}
+
+void schedule_event(gb_scheduler_t *scheduler, gb_event_t event, uint64_t when) {
+	scheduler->when[event] = when;
+	_update_next(scheduler);
+}
+
+void cancel_event(gb_scheduler_t *scheduler, gb_event_t event) {
+	scheduler->when[event] = EVENT_NEVER;
+	_update_next(scheduler);
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef scheduler_h
+#define scheduler_h
+
+#include <stdint.h>
+
+#define EVENT_NEVER UINT64_MAX
+
+/* hardware events, in the order they are dispatched when due on the same cycle */
+typedef enum {
+	GB_EVENT_PPU,
+	GB_EVENT_TIMER,
+	GB_EVENT_RTC,
+	GB_EVENT_COUNT
+} gb_event_t;
+
+typedef struct {
+	uint64_t now;
+	uint64_t next;
+	uint64_t when[GB_EVENT_COUNT];
+} gb_scheduler_t;
+
+void init_scheduler(gb_scheduler_t *scheduler);
+void schedule_event(gb_scheduler_t *scheduler, gb_event_t event, uint64_t when);
+void cancel_event(gb_scheduler_t *scheduler, gb_event_t event);
+
+#endif
@@ -0,0 +1,143 @@
+#include <string.h>
+#include <stdatomic.h>
+#include "simd.h"
+
+#if !defined(GB_NO_SIMD) && defined(__GNUC__) && defined(__SSE2__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+static void _expand_line_scalar(const uint8_t *indices, const uint32_t colours[12], uint32_t *out, int count) {
+	for (int x = 0; x < count; x++)
+		out[x] = colours[indices[x]];
+}
+
+typedef void (*gb_expand_line_t)(const uint8_t *, const uint32_t *, uint32_t *, int);
+
+/* every ppu calls init_simd, possibly from several threads at once, so the choice is stored atomically */
+static _Atomic(gb_expand_line_t) _expand_line = _expand_line_scalar;
+
+#ifdef SIMD_X86
+
+/* one 16 entry byte table per channel for the shuffles, pixels are stored r, g, b, a in memory */
+static void _channel_tables(const uint32_t colours[12], uint8_t tables[4][16]) {
+	memset(tables, 0, 4 * 16);
+	for (int i = 0; i < 12; i++)
+		for (int channel = 0; channel < 4; channel++)
+			tables[channel][i] = ((const uint8_t *)&colours[i])[channel];
+}
+
+__attribute__((target("ssse3")))
+static void _expand_line_ssse3(const uint8_t *indices, const uint32_t colours[12], uint32_t *out, int count) {
+	uint8_t tables[4][16];
+	_channel_tables(colours, tables);
+	__m128i r = _mm_loadu_si128((const __m128i *)tables[0]);
+	__m128i g = _mm_loadu_si128((const __m128i *)tables[1]);
+	__m128i b = _mm_loadu_si128((const __m128i *)tables[2]);
+	__m128i a = _mm_loadu_si128((const __m128i *)tables[3]);
+
+	int x = 0;
+	for (; x + 16 <= count; x += 16) {
+		__m128i index = _mm_loadu_si128((const __m128i *)(indices + x));
+		__m128i rv = _mm_shuffle_epi8(r, index);
+		__m128i gv = _mm_shuffle_epi8(g, index);
+		__m128i bv = _mm_shuffle_epi8(b, index);
+		__m128i av = _mm_shuffle_epi8(a, index);
+		__m128i rg_low = _mm_unpacklo_epi8(rv, gv);
+		__m128i rg_high = _mm_unpackhi_epi8(rv, gv);
+		__m128i ba_low = _mm_unpacklo_epi8(bv, av);
+		__m128i ba_high = _mm_unpackhi_epi8(bv, av);
+		_mm_storeu_si128((__m128i *)(out + x), _mm_unpacklo_epi16(rg_low, ba_low));
+		_mm_storeu_si128((__m128i *)(out + x + 4), _mm_unpackhi_epi16(rg_low, ba_low));
+		_mm_storeu_si128((__m128i *)(out + x + 8), _mm_unpacklo_epi16(rg_high, ba_high));
+		_mm_storeu_si128((__m128i *)(out + x + 12), _mm_unpackhi_epi16(rg_high, ba_high));
+	}
+	_expand_line_scalar(indices + x, colours, out + x, count - x);
+}
+
+__attribute__((target("avx2")))
+static void _expand_line_avx2(const uint8_t *indices, const uint32_t colours[12], uint32_t *out, int count) {
+	uint8_t tables[4][16];
+	_channel_tables(colours, tables);
+	// vpshufb looks up within each 128 bit lane, so both lanes carry the same table
+	__m256i r = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tables[0]));
+	__m256i g = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tables[1]));
+	__m256i b = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tables[2]));
+	__m256i a = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tables[3]));
+
+	int x = 0;
+	for (; x + 32 <= count; x += 32) {
+		__m256i index = _mm256_loadu_si256((const __m256i *)(indices + x));
+		__m256i rv = _mm256_shuffle_epi8(r, index);
+		__m256i gv = _mm256_shuffle_epi8(g, index);
+		__m256i bv = _mm256_shuffle_epi8(b, index);
+		__m256i av = _mm256_shuffle_epi8(a, index);
+		__m256i rg_low = _mm256_unpacklo_epi8(rv, gv);
+		__m256i rg_high = _mm256_unpackhi_epi8(rv, gv);
+		__m256i ba_low = _mm256_unpacklo_epi8(bv, av);
+		__m256i ba_high = _mm256_unpackhi_epi8(bv, av);
+		// the unpacks work per 128 bit lane, so pixels 0-15 and 16-31 come out interleaved by lane
+		__m256i p0 = _mm256_unpacklo_epi16(rg_low, ba_low);
+		__m256i p1 = _mm256_unpackhi_epi16(rg_low, ba_low);
+		__m256i p2 = _mm256_unpacklo_epi16(rg_high, ba_high);
+		__m256i p3 = _mm256_unpackhi_epi16(rg_high, ba_high);
+		_mm256_storeu_si256((__m256i *)(out + x), _mm256_permute2x128_si256(p0, p1, 0x20));
+		_mm256_storeu_si256((__m256i *)(out + x + 8), _mm256_permute2x128_si256(p2, p3, 0x20));
+		_mm256_storeu_si256((__m256i *)(out + x + 16), _mm256_permute2x128_si256(p0, p1, 0x31));
+		_mm256_storeu_si256((__m256i *)(out + x + 24), _mm256_permute2x128_si256(p2, p3, 0x31));
+	}
+	_expand_line_ssse3(indices + x, colours, out + x, count - x);
+}
+
+/* two rows per register, each bit plane byte is tested against one mask byte per pixel */
+void decode_tile(const uint8_t data[16], uint8_t plain[8][8], uint8_t flipped[8][8]) {
+	const __m128i forward = _mm_setr_epi8(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+	const __m128i backward = _mm_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80);
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i two = _mm_set1_epi8(2);
+
+	for (int row = 0; row < 8; row += 2) {
+		__m128i low = _mm_unpacklo_epi64(_mm_set1_epi8(data[row * 2]), _mm_set1_epi8(data[row * 2 + 2]));
+		__m128i high = _mm_unpacklo_epi64(_mm_set1_epi8(data[row * 2 + 1]), _mm_set1_epi8(data[row * 2 + 3]));
+
+		__m128i colour = _mm_or_si128(
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(low, forward), forward), one),
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(high, forward), forward), two));
+		_mm_storeu_si128((__m128i *)plain[row], colour);
+
+		colour = _mm_or_si128(
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(low, backward), backward), one),
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(high, backward), backward), two));
+		_mm_storeu_si128((__m128i *)flipped[row], colour);
+	}
+}
+
+void init_simd(void) {
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		atomic_store_explicit(&_expand_line, _expand_line_avx2, memory_order_relaxed);
+	else if (__builtin_cpu_supports("ssse3"))
+		atomic_store_explicit(&_expand_line, _expand_line_ssse3, memory_order_relaxed);
+}
+
+#else
+
+void decode_tile(const uint8_t data[16], uint8_t plain[8][8], uint8_t flipped[8][8]) {
+	for (int row = 0; row < 8; row++) {
+		uint8_t low = data[row * 2];
+		uint8_t high = data[row * 2 + 1];
+		for (int x = 0; x < 8; x++) {
+			uint8_t colour = ((low >> (7 - x)) & 1) | (((high >> (7 - x)) & 1) << 1);
+			plain[row][x] = colour;
+			flipped[row][7 - x] = colour;
+		}
+	}
+}
+
+void init_simd(void) {}
+
+#endif
+
+void expand_line(const uint8_t *indices, const uint32_t colours[12], uint32_t *out, int count) {
+	atomic_load_explicit(&_expand_line, memory_order_relaxed)(indices, colours, out, count);
+}
@@ -0,0 +1,14 @@
+#ifndef simd_h
+#define simd_h
+
+#include <stdint.h>
+
+/*
+ * the ppu's two inner loops. x86 builds use sse2 for tile decoding and pick avx2 or ssse3 for
+ * palette expansion at runtime, everything else (or -DGB_NO_SIMD) gets the scalar versions
+ */
+void init_simd(void);
+void decode_tile(const uint8_t data[16], uint8_t plain[8][8], uint8_t flipped[8][8]);
+void expand_line(const uint8_t *indices, const uint32_t colours[12], uint32_t *out, int count);
+
+#endif
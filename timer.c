@@ -0,0 +1,82 @@
+#include "timer.h"
+#include "scheduler.h"
+
+/* tima ticks when this counter bit falls, so once every twice its value */
+static const uint16_t _periods[4] = {1024, 16, 64, 256};
+
+static inline uint64_t _period(gb_timer_t *timer) {
+	return _periods[timer->tac & 3];
+}
+
+static inline uint64_t _edges(gb_timer_t *timer, uint64_t from, uint64_t to) {
+	uint64_t period = _period(timer);
+	return (to - timer->base) / period - (from - timer->base) / period;
+}
+
+static void _tick(gb_timer_t *timer, uint64_t edges) {
+	while (edges) {
+		uint64_t step = 0x100 - timer->tima;
+		if (edges < step) {
+			timer->tima += edges;
+			return;
+		}
+		edges -= step;
+		timer->tima = timer->tma;
+		timer->interrupts |= INTERRUPT_TIMER;
+	}
+}
+
+void init_timer(gb_timer_t *timer) {
+	timer->base = 0;
+	timer->synced = 0;
+	timer->tima = 0;
+	timer->tma = 0;
+	timer->tac = 0xf8;
+	timer->interrupts = 0;
+}
+
+/* brings tima up to now, overflows reload tma and raise the interrupt on the way */
+void timer_sync(gb_timer_t *timer, uint64_t now) {
+	if (timer->tac & TAC_ENABLE)
+		_tick(timer, _edges(timer, timer->synced, now));
+	timer->synced = now;
+}
+
+/* when tima next wraps, counted from the last sync */
+uint64_t timer_overflow(gb_timer_t *timer) {
+	if (!(timer->tac & TAC_ENABLE))
+		return EVENT_NEVER;
+	uint64_t period = _period(timer);
+	uint64_t edge = (timer->synced - timer->base) / period + (0x100 - timer->tima);
+	return timer->base + edge * period;
+}
+
+uint8_t timer_read(gb_timer_t *timer, uint64_t now, uint16_t address) {
+	switch (address) {
+		case 0xff04: return (now - timer->base) >> 8;
+		case 0xff05: timer_sync(timer, now); return timer->tima;
+		case 0xff06: return timer->tma;
+		default: return timer->tac;
+	}
+}
+
+void timer_write(gb_timer_t *timer, uint64_t now, uint16_t address, uint8_t value) {
+	timer_sync(timer, now);
+	switch (address) {
+		case 0xff04:
+			// clearing the counter drops the selected bit, which ticks tima if it was set
+			if ((timer->tac & TAC_ENABLE) && ((now - timer->base) & (_period(timer) >> 1)))
+				_tick(timer, 1);
+			timer->base = now;
+			break;
+		case 0xff05:
+			timer->tima = value;
+			break;
+		case 0xff06:
+			timer->tma = value;
+			break;
+		default:
+			timer->tac = value | 0xf8;
+			break;
+	}
+}
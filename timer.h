@@ -0,0 +1,29 @@
+#ifndef timer_h
+#define timer_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define INTERRUPT_TIMER 0x04
+#define TAC_ENABLE 0x04
+
+/*
+ * nothing here counts cycles. the 16 bit system counter is now - base, div is its top byte and
+ * tima counts falling edges of the counter bit tac selects, caught up whenever it is looked at
+ */
+typedef struct {
+	uint64_t base;
+	uint64_t synced;
+	uint16_t tima;
+	uint8_t tma;
+	uint8_t tac;
+	uint8_t interrupts;
+} gb_timer_t;
+
+void init_timer(gb_timer_t *timer);
+uint8_t timer_read(gb_timer_t *timer, uint64_t now, uint16_t address);
+void timer_write(gb_timer_t *timer, uint64_t now, uint16_t address, uint8_t value);
+void timer_sync(gb_timer_t *timer, uint64_t now);
+uint64_t timer_overflow(gb_timer_t *timer);
+
+#endif
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <string.h>
+#include "cpu.h"
+#include "jit.h"
+
+/*
+ * small programs assembled in memory and run without the boot rom, each under the interpreter,
+ * the jit and the checked jit. a case passes when the registers it names end up as expected
+ */
+
+typedef struct {
+	const char *name;
+	const uint8_t *code;
+	size_t size;
+	uint8_t b;
+	uint8_t c;
+} gb_case_t;
+
+/*
+ * writes ld a, 0x11 / ret into tile data, calls it often enough for the jit to compile it, then
+ * patches the operand to 0x22 and calls it again. b holds the first result and c the second
+ */
+static const uint8_t _code_in_vram[] = {
+	0x31, 0xfe, 0xff,       // ld sp, 0xfffe
+	0x21, 0x00, 0x80,       // ld hl, 0x8000
+	0x36, 0x3e,             // ld (hl), 0x3e
+	0x23,                   // inc hl
+	0x36, 0x11,             // ld (hl), 0x11
+	0x23,                   // inc hl
+	0x36, 0xc9,             // ld (hl), 0xc9
+	0x16, 0x20,             // ld d, 0x20
+	0xcd, 0x00, 0x80,       // call 0x8000
+	0x15,                   // dec d
+	0x20, 0xfa,             // jr nz, -6
+	0x47,                   // ld b, a
+	0x21, 0x01, 0x80,       // ld hl, 0x8001
+	0x36, 0x22,             // ld (hl), 0x22
+	0xcd, 0x00, 0x80,       // call 0x8000
+	0x4f,                   // ld c, a
+	0x18, 0xfe,             // jr -2
+};
+
+/*
+ * clears div partway through a hot loop with tima running at its fastest, every clear can tick
+ * tima depending on when it lands. b holds tima after the loop and c div a few instructions later
+ */
+static const uint8_t _div_reset[] = {
+	0x31, 0xfe, 0xff,       // ld sp, 0xfffe
+	0xaf,                   // xor a
+	0xe0, 0x06,             // ldh (0x06), a
+	0xe0, 0x05,             // ldh (0x05), a
+	0x3e, 0x05,             // ld a, 0x05
+	0xe0, 0x07,             // ldh (0x07), a
+	0x16, 0x40,             // ld d, 0x40
+	0x00,                   // nop
+	0x00,                   // nop
+	0xe0, 0x04,             // ldh (0x04), a
+	0x00,                   // nop
+	0x15,                   // dec d
+	0x20, 0xf8,             // jr nz, -8
+	0xf0, 0x05,             // ldh a, (0x05)
+	0x47,                   // ld b, a
+	0x16, 0x30,             // ld d, 0x30
+	0x15,                   // dec d
+	0x20, 0xfd,             // jr nz, -3
+	0xf0, 0x04,             // ldh a, (0x04)
+	0x4f,                   // ld c, a
+	0x18, 0xfe,             // jr -2
+};
+
+static const gb_case_t _cases[] = {
+	{"code in vram", _code_in_vram, sizeof(_code_in_vram), 0x11, 0x22},
+	{"div reset", _div_reset, sizeof(_div_reset), 0xc0, 0x03},
+};
+
+static uint8_t _rom[0x8000];
+
+static bool _run(const gb_case_t *test, int mode) {
+	static gb_cpu_t cpu;
+	static gb_ppu_t ppu;
+	static gb_cart_t cart;
+
+	memset(_rom, 0, sizeof(_rom));
+	_rom[0x100] = 0xc3;     // jp 0x150
+	_rom[0x101] = 0x50;
+	_rom[0x102] = 0x01;
+	memcpy(_rom + 0x150, test->code, test->size);
+	if (!init_cart(&cart, _rom, sizeof(_rom)))
+		return 0;
+	init_ppu(&ppu);
+	init_cpu(&cpu, &ppu, &cart);
+	cpu.pc = 0x100;
+	if (mode && !(cpu.jit = init_jit(&cpu, mode == 2))) {
+		printf("%s: skipped without the jit\n", test->name);
+		free_cart(&cart);
+		return 1;
+	}
+
+	for (int frame = 1; frame <= 4; frame++)
+		run_until(&cpu, (uint64_t)frame * CYCLES_PER_FRAME);
+	bool passed = cpu.b == test->b && cpu.c == test->c;
+	static const char *modes[] = {"interpreter", "jit", "jit verify"};
+	printf("%s, %s: %s (b=%02x c=%02x)\n", test->name, modes[mode], passed ? "ok" : "FAILED", cpu.b, cpu.c);
+
+	if (cpu.jit)
+		free_jit(cpu.jit);
+	free_cart(&cart);
+	return passed;
+}
+
+int main(void) {
+	int failed = 0;
+	for (size_t i = 0; i < sizeof(_cases) / sizeof(_cases[0]); i++)
+		for (int mode = 0; mode < 3; mode++)
+			failed += !_run(&_cases[i], mode);
+	return failed != 0;
+}
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "instance.h"
+#include "savestate.h"
+#include "movie.h"
+#include "pool.h"
+#include "utils.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/*
+ * runs every job in a manifest headless across a pool of threads. each line is a rom, a frame
+ * count and optionally a movie to replay, with # starting a comment. a frame count of 0 with a
+ * movie runs the movie's length. results are printed in manifest order once every job is done
+ */
+
+typedef struct {
+	char *rom;
+	char *movie;
+	long frames;
+
+	const char *error;
+	uint32_t state_hash;
+	uint32_t framebuffer_hash;
+	uint64_t cycles;
+	double seconds;
+} gb_job_t;
+
+typedef struct {
+	gb_job_t *jobs;
+	gb_instance_t **instances;
+} gb_runner_t;
+
+static double _seconds(void) {
+#ifdef _WIN32
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (double)counter.QuadPart / frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+#endif
+}
+
+static uint32_t _hash(const void *data, size_t size) {
+	const uint8_t *bytes = data;
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 16777619u;
+	return hash;
+}
+
+static void _run(gb_job_t *job, gb_instance_t *instance) {
+	if (!instance_reset(instance, job->rom, NULL, 0)) {
+		job->error = "failed to load rom";
+		return;
+	}
+
+	// without a movie the buttons never change, so only the last frame needs drawing
+	if (!job->movie) {
+		instance_step(instance, 0, job->frames);
+	} else {
+		gb_movie_t *movie = replay_movie(&instance->cpu, job->movie);
+		if (!movie) {
+			job->error = "failed to open movie";
+			return;
+		}
+		long frames = job->frames ? job->frames : movie->frames;
+		for (long frame = 0; frame < frames; frame++)
+			instance_step(instance, movie_frame(movie, 0), 1);
+		close_movie(movie);
+	}
+	drawDisplay(&instance->ppu);
+	job->state_hash = state_hash(&instance->cpu);
+	job->framebuffer_hash = _hash(instance->ppu.pixels, sizeof(instance->ppu.pixels));
+	job->cycles = instance->cpu.scheduler.now;
+}
+
+static void _run_job(void *context, size_t index, int worker) {
+	gb_runner_t *runner = context;
+	gb_job_t *job = &runner->jobs[index];
+	double start = _seconds();
+	_run(job, runner->instances[worker]);
+	job->seconds = _seconds() - start;
+}
+
+static char *_copy(const char *text) {
+	char *copy = malloc(strlen(text) + 1);
+	if (copy)
+		strcpy(copy, text);
+	return copy;
+}
+
+static gb_job_t *_read_manifest(FILE *file, size_t *count) {
+	gb_job_t *jobs = NULL;
+	size_t capacity = 0;
+	char line[4096];
+	int number = 0;
+	*count = 0;
+	while (fgets(line, sizeof(line), file)) {
+		number++;
+		char *comment = strchr(line, '#');
+		if (comment)
+			*comment = 0;
+		char *rom = strtok(line, " \t\r\n");
+		if (!rom)
+			continue;
+		char *frames = strtok(NULL, " \t\r\n");
+		char *movie = strtok(NULL, " \t\r\n");
+		char *end = NULL;
+		long count_frames = frames ? strtol(frames, &end, 10) : -1;
+		if (!frames || *end || count_frames < 0 || (!count_frames && !movie) || strtok(NULL, " \t\r\n")) {
+			fprintf(stderr, "Bad manifest line %d.\n", number);
+			continue;
+		}
+
+		if (*count == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			gb_job_t *grown = realloc(jobs, capacity * sizeof(gb_job_t));
+			if (!grown)
+				break;
+			jobs = grown;
+		}
+		gb_job_t *job = &jobs[(*count)++];
+		memset(job, 0, sizeof(gb_job_t));
+		job->rom = _copy(rom);
+		job->movie = movie ? _copy(movie) : NULL;
+		job->frames = count_frames;
+	}
+	return jobs;
+}
+
+int main(int argc, char **argv) {
+	int workers = pool_default_workers();
+	bool jit = false;
+	const char *manifest_path = NULL, *output_path = NULL, *boot_path = "bootloader.bin";
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--workers") && i + 1 < argc)
+			workers = strtol(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--jit"))
+			jit = true;
+		else if (!strcmp(argv[i], "--boot") && i + 1 < argc)
+			boot_path = argv[++i];
+		else if (!strcmp(argv[i], "--output") && i + 1 < argc)
+			output_path = argv[++i];
+		else
+			manifest_path = argv[i];
+	}
+	if (!manifest_path) {
+		fprintf(stderr, "Usage:\nrunner [--workers n] [--jit] [--boot file] [--output file] <manifest | ->\n");
+		return 1;
+	}
+
+	FILE *manifest = strcmp(manifest_path, "-") ? fopen(manifest_path, "r") : stdin;
+	if (!manifest) {
+		err("Failed to open manifest.\n");
+		return 1;
+	}
+	size_t count;
+	gb_job_t *jobs = _read_manifest(manifest, &count);
+	if (manifest != stdin)
+		fclose(manifest);
+
+	FILE *output = output_path ? fopen(output_path, "w") : stdout;
+	if (!output) {
+		err("Failed to open output file.\n");
+		return 1;
+	}
+
+	if (workers < 1)
+		workers = 1;
+	if ((size_t)workers > count)
+		workers = count ? count : 1;
+	// too big for a thread's stack, so each worker gets one instance up front and reuses it for every job
+	gb_runner_t runner = {jobs, calloc(workers, sizeof(gb_instance_t *))};
+	if (!runner.instances)
+		return 1;
+	for (int w = 0; w < workers; w++)
+		if (!(runner.instances[w] = open_instance(boot_path, jit)))
+			return 1;
+
+	double start = _seconds();
+	if (!run_pool(workers, count, _run_job, &runner)) {
+		err("Failed to start the workers.\n");
+		return 1;
+	}
+	double seconds = _seconds() - start;
+
+	size_t failed = 0;
+	fprintf(output, "rom\tframes\tmovie\tstate_hash\tframebuffer_hash\tcycles\tseconds\n");
+	for (size_t i = 0; i < count; i++) {
+		gb_job_t *job = &jobs[i];
+		fprintf(output, "%s\t%ld\t%s\t", job->rom, job->frames, job->movie ? job->movie : "-");
+		if (job->error) {
+			fprintf(output, "error: %s\n", job->error);
+			failed++;
+		} else {
+			fprintf(output, "%08x\t%08x\t%llu\t%.3f\n", job->state_hash, job->framebuffer_hash, (unsigned long long)job->cycles, job->seconds);
+		}
+	}
+	fprintf(stderr, "%zu jobs on %d workers in %.2fs, %zu failed.\n", count, workers, seconds, failed);
+
+	if (output != stdout)
+		fclose(output);
+	for (int w = 0; w < workers; w++)
+		close_instance(runner.instances[w]);
+	free(runner.instances);
+	for (size_t i = 0; i < count; i++) {
+		free(jobs[i].rom);
+		free(jobs[i].movie);
+	}
+	free(jobs);
+	return failed != 0;
+}
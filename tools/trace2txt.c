@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+
+/*
+ * turns a binary trace back into the old dump.txt layout for diffing against other emulators,
+ * --cycles prefixes every entry with its cycle count
+ */
+static void _print_record(FILE *out, const gb_trace_record_t *record, bool cycles) {
+	uint8_t size = record->length;
+	uint32_t instruction = record->opcode[0] << 24;
+	if (size > 1) {
+		instruction |= record->opcode[size - 1] << 16;
+		if (size > 2)
+			instruction |= record->opcode[1] << 8;
+	}
+	uint8_t registers[] = {record->bc >> 8, record->bc, record->de >> 8, record->de, record->hl >> 8, record->hl};
+	static const char x[] = "bcdehl";
+
+	if (cycles)
+		fprintf(out, "cycle: %llu\n", (unsigned long long)record->cycle);
+	fprintf(out, "instruction: 0x%x, pc: 0x%x, sp:0x%x\n", instruction, (uint16_t)(record->pc + size), record->sp);
+	for (int i = 0; i < 6; i++)
+		fprintf(out, "%c: 0x%x, ", x[i], registers[i]);
+	// the old dump printed the unused byte at address 0 as z, which always read 0
+	fprintf(out, "z: 0x0, ");
+	fprintf(out, "f, 0x%x, hl: 0x%x, af: 0x%x, bc: 0x%x, de: 0x%x ", record->af & 0xff, record->hl, record->af, record->bc, record->de);
+	fprintf(out, "\n\n");
+}
+
+int main(int argc, char *argv[]) {
+	bool cycles = false;
+	const char *in_path = NULL, *out_path = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--cycles"))
+			cycles = true;
+		else if (!in_path)
+			in_path = argv[i];
+		else
+			out_path = argv[i];
+	}
+	if (!in_path) {
+		fprintf(stderr, "Usage:\ntrace2txt [--cycles] <trace file> [text file]\n");
+		return 1;
+	}
+
+	FILE *in = fopen(in_path, "rb");
+	if (!in || !read_trace_header(in)) {
+		fprintf(stderr, "Failed to read trace file.\n");
+		return 1;
+	}
+	FILE *out = out_path ? fopen(out_path, "w") : stdout;
+	if (!out) {
+		fprintf(stderr, "Failed to open output file.\n");
+		return 1;
+	}
+
+	static gb_trace_record_t records[TRACE_CHUNK_RECORDS];
+	uint32_t count;
+	while (read_trace_chunk(in, records, &count)) {
+		for (uint32_t i = 0; i < count; i++)
+			_print_record(out, &records[i], cycles);
+	}
+	if (!feof(in))
+		fprintf(stderr, "Trace file is damaged, stopping early.\n");
+
+	fclose(in);
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
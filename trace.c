@@ -0,0 +1,272 @@
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+#include "utils.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+static void _yield(void) {
+#ifdef _WIN32
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+static void _nap(void) {
+#ifdef _WIN32
+	Sleep(1);
+#else
+	struct timespec delay = {0, 1000000};
+	nanosleep(&delay, NULL);
+#endif
+}
+
+/*
+ * each record is xored with the one before it, except the cycle which is stored as a difference,
+ * then only the non zero bytes are kept behind a mask of which ones they are
+ */
+static size_t _compress(const gb_trace_record_t *records, uint32_t count, uint8_t *out) {
+	uint8_t previous[sizeof(gb_trace_record_t)] = {0};
+	uint64_t cycle = 0;
+	uint8_t *start = out;
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint8_t delta[sizeof(gb_trace_record_t)];
+		uint64_t difference = records[i].cycle - cycle;
+		cycle = records[i].cycle;
+		memcpy(delta, &records[i], sizeof(delta));
+		for (size_t j = sizeof(uint64_t); j < sizeof(delta); j++) {
+			uint8_t byte = delta[j];
+			delta[j] ^= previous[j];
+			previous[j] = byte;
+		}
+		memcpy(delta, &difference, sizeof(difference));
+
+		uint32_t mask = 0;
+		uint8_t *mask_out = out;
+		out += 3;
+		for (size_t j = 0; j < sizeof(delta); j++) {
+			if (delta[j]) {
+				mask |= 1 << j;
+				*out++ = delta[j];
+			}
+		}
+		mask_out[0] = mask;
+		mask_out[1] = mask >> 8;
+		mask_out[2] = mask >> 16;
+	}
+	return out - start;
+}
+
+static bool _decompress(const uint8_t *in, size_t size, gb_trace_record_t *records, uint32_t count) {
+	uint8_t previous[sizeof(gb_trace_record_t)] = {0};
+	uint64_t cycle = 0;
+	const uint8_t *end = in + size;
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (end - in < 3)
+			return 0;
+		uint32_t mask = in[0] | in[1] << 8 | in[2] << 16;
+		in += 3;
+
+		uint8_t delta[sizeof(gb_trace_record_t)] = {0};
+		for (size_t j = 0; j < sizeof(delta); j++) {
+			if (mask & (1 << j)) {
+				if (in == end)
+					return 0;
+				delta[j] = *in++;
+			}
+		}
+
+		uint64_t difference;
+		memcpy(&difference, delta, sizeof(difference));
+		cycle += difference;
+		memcpy(delta, &cycle, sizeof(cycle));
+		for (size_t j = sizeof(uint64_t); j < sizeof(delta); j++) {
+			delta[j] ^= previous[j];
+			previous[j] = delta[j];
+		}
+		memcpy(&records[i], delta, sizeof(delta));
+	}
+	return in == end;
+}
+
+static bool _write_chunk(FILE *file, uint8_t *buffer, const gb_trace_record_t *records, uint32_t count) {
+	gb_trace_chunk_t chunk = {_compress(records, count, buffer), count};
+	return fwrite(&chunk, sizeof(chunk), 1, file) == 1 && fwrite(buffer, 1, chunk.size, file) == chunk.size;
+}
+
+static void _drain(gb_trace_t *trace, size_t head, uint32_t count) {
+	gb_trace_record_t records[TRACE_CHUNK_RECORDS];
+	// the ring wraps, so copy the records out in order before compressing
+	for (uint32_t i = 0; i < count; i++)
+		records[i] = trace->ring[(head + i) & (TRACE_RING_SIZE - 1)];
+	atomic_store_explicit(&trace->head, head + count, memory_order_release);
+
+	if (!_write_chunk(trace->file, trace->chunk, records, count))
+		err("Failed to write trace.\n");
+}
+
+/* drains the ring a chunk at a time, and whatever is left once the trace is closed */
+static void _writer(gb_trace_t *trace) {
+	for (;;) {
+		bool closing = atomic_load_explicit(&trace->closing, memory_order_acquire);
+		size_t head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+		size_t tail = atomic_load_explicit(&trace->tail, memory_order_acquire);
+
+		if (tail == head) {
+			if (closing)
+				break;
+			_nap();
+			continue;
+		}
+		// small batches only go out once the producer has gone quiet or is finished
+		if (tail - head < TRACE_CHUNK_RECORDS && !closing) {
+			_nap();
+			if (atomic_load_explicit(&trace->tail, memory_order_acquire) != tail)
+				continue;
+		}
+		uint32_t count = tail - head < TRACE_CHUNK_RECORDS ? tail - head : TRACE_CHUNK_RECORDS;
+		_drain(trace, head, count);
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI _thread(LPVOID trace) {
+	_writer(trace);
+	return 0;
+}
+#else
+static void *_thread(void *trace) {
+	_writer(trace);
+	return NULL;
+}
+#endif
+
+/* malloc only promises max_align_t, the head and tail need their own cache lines to stop false sharing */
+static gb_trace_t *_alloc_trace(void) {
+	size_t size = (sizeof(gb_trace_t) + 63) & ~(size_t)63;
+#ifdef _WIN32
+	return _aligned_malloc(size, 64);
+#else
+	return aligned_alloc(64, size);
+#endif
+}
+
+static void _free_trace(gb_trace_t *trace) {
+#ifdef _WIN32
+	_aligned_free(trace);
+#else
+	free(trace);
+#endif
+}
+
+gb_trace_t *open_trace(const char *path, bool drop) {
+	gb_trace_t *trace = _alloc_trace();
+	if (!trace)
+		return NULL;
+	trace->file = fopen(path, "wb");
+	if (!trace->file) {
+		_free_trace(trace);
+		return NULL;
+	}
+	atomic_init(&trace->head, 0);
+	atomic_init(&trace->tail, 0);
+	atomic_init(&trace->closing, 0);
+	trace->cached_head = 0;
+	trace->dropped = 0;
+	trace->drop = drop;
+
+	write_trace_header(trace->file);
+
+#ifdef _WIN32
+	trace->thread = CreateThread(NULL, 0, _thread, trace, 0, NULL);
+	bool started = trace->thread != NULL;
+#else
+	pthread_t *thread = malloc(sizeof(pthread_t));
+	bool started = thread && !pthread_create(thread, NULL, _thread, trace);
+	trace->thread = thread;
+#endif
+	if (!started) {
+#ifndef _WIN32
+		free(thread);
+#endif
+		fclose(trace->file);
+		_free_trace(trace);
+		return NULL;
+	}
+	return trace;
+}
+
+/* called by the emulation thread while the ring is full and the trace is lossless */
+void trace_wait(gb_trace_t *trace) {
+	size_t tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+	while (tail - (trace->cached_head = atomic_load_explicit(&trace->head, memory_order_acquire)) == TRACE_RING_SIZE)
+		_yield();
+}
+
+void close_trace(gb_trace_t *trace) {
+	atomic_store_explicit(&trace->closing, 1, memory_order_release);
+#ifdef _WIN32
+	WaitForSingleObject(trace->thread, INFINITE);
+	CloseHandle(trace->thread);
+#else
+	pthread_join(*(pthread_t *)trace->thread, NULL);
+	free(trace->thread);
+#endif
+	if (trace->dropped)
+		fprintf(stderr, "Trace dropped %llu records.\n", (unsigned long long)trace->dropped);
+	fclose(trace->file);
+	_free_trace(trace);
+}
+
+size_t encode_trace_header(uint8_t *out) {
+	gb_trace_header_t header = {TRACE_MAGIC, TRACE_VERSION, sizeof(gb_trace_record_t)};
+	memcpy(out, &header, sizeof(header));
+	return sizeof(header);
+}
+
+void write_trace_header(FILE *file) {
+	uint8_t header[sizeof(gb_trace_header_t)];
+	fwrite(header, encode_trace_header(header), 1, file);
+}
+
+/* records as the chunks a trace file holds, into memory. it only calls memcpy, so it's safe in a signal handler */
+size_t encode_trace_records(uint8_t *out, const gb_trace_record_t *records, size_t count) {
+	uint8_t *start = out;
+	for (size_t i = 0; i < count; i += TRACE_CHUNK_RECORDS) {
+		uint32_t size = count - i < TRACE_CHUNK_RECORDS ? count - i : TRACE_CHUNK_RECORDS;
+		gb_trace_chunk_t chunk = {_compress(records + i, size, out + sizeof(chunk)), size};
+		memcpy(out, &chunk, sizeof(chunk));
+		out += sizeof(chunk) + chunk.size;
+	}
+	return out - start;
+}
+
+/* rejects files from another version, the record layout is only checked by size */
+bool read_trace_header(FILE *file) {
+	gb_trace_header_t header;
+	if (fread(&header, sizeof(header), 1, file) != 1)
+		return 0;
+	return !memcmp(header.magic, TRACE_MAGIC, 4) && header.version == TRACE_VERSION && header.record_size == sizeof(gb_trace_record_t);
+}
+
+/* records has to hold TRACE_CHUNK_RECORDS, returns false at the end of the file or on a bad chunk */
+bool read_trace_chunk(FILE *file, gb_trace_record_t *records, uint32_t *count) {
+	static uint8_t payload[TRACE_CHUNK_BOUND];
+	gb_trace_chunk_t chunk;
+	if (fread(&chunk, sizeof(chunk), 1, file) != 1)
+		return 0;
+	if (chunk.count > TRACE_CHUNK_RECORDS || chunk.size > TRACE_CHUNK_BOUND || fread(payload, 1, chunk.size, file) != chunk.size)
+		return 0;
+	*count = chunk.count;
+	return _decompress(payload, chunk.size, records, chunk.count);
+}
@@ -0,0 +1,93 @@
+#ifndef trace_h
+#define trace_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define TRACE_MAGIC "GBTR"
+#define TRACE_VERSION 3
+#define TRACE_RING_SIZE (1 << 16)
+#define TRACE_CHUNK_RECORDS 4096
+
+/*
+ * written before the instruction runs, fields are little endian like the host registers.
+ * af through pc are in the same order as in gb_cpu_t so they are captured with one copy
+ */
+typedef struct {
+	uint64_t cycle;
+	uint16_t af;
+	uint16_t bc;
+	uint16_t de;
+	uint16_t hl;
+	uint16_t sp;
+	uint16_t pc;
+	uint8_t opcode[3];
+	uint8_t length;
+} gb_trace_record_t;
+
+typedef struct {
+	char magic[4];
+	uint16_t version;
+	uint16_t record_size;
+} gb_trace_header_t;
+
+/* the file is a header followed by chunks, each one delta coded from an all zero record */
+typedef struct {
+	uint32_t size;
+	uint32_t count;
+} gb_trace_chunk_t;
+
+/* the largest a chunk's payload can get, a byte mask per record plus every byte changed */
+#define TRACE_CHUNK_BOUND (TRACE_CHUNK_RECORDS * (3 + sizeof(gb_trace_record_t)))
+/* the most encode_trace_records can write for count records */
+#define TRACE_ENCODED_BOUND(count) (((count) / TRACE_CHUNK_RECORDS + 1) * (sizeof(gb_trace_chunk_t) + TRACE_CHUNK_BOUND))
+
+/*
+ * records go through a single producer single consumer ring to a writer thread that compresses
+ * and writes them, so the emulation thread never waits on the disk unless the ring fills up
+ */
+typedef struct {
+	_Alignas(64) atomic_size_t tail;
+	size_t cached_head;
+	uint64_t dropped;
+	bool drop;
+
+	_Alignas(64) atomic_size_t head;
+	atomic_bool closing;
+	FILE *file;
+	void *thread;
+
+	gb_trace_record_t ring[TRACE_RING_SIZE];
+	uint8_t chunk[TRACE_CHUNK_BOUND];
+} gb_trace_t;
+
+gb_trace_t *open_trace(const char *path, bool drop);
+void close_trace(gb_trace_t *trace);
+void trace_wait(gb_trace_t *trace);
+size_t encode_trace_header(uint8_t *out);
+void write_trace_header(FILE *file);
+size_t encode_trace_records(uint8_t *out, const gb_trace_record_t *records, size_t count);
+bool read_trace_header(FILE *file);
+bool read_trace_chunk(FILE *file, gb_trace_record_t *records, uint32_t *count);
+
+/* full rings either lose the record or wait for the writer, depending on how the trace was opened */
+static inline void trace_write(gb_trace_t *trace, const gb_trace_record_t *record) {
+	size_t tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+	if (tail - trace->cached_head == TRACE_RING_SIZE) {
+		trace->cached_head = atomic_load_explicit(&trace->head, memory_order_acquire);
+		if (tail - trace->cached_head == TRACE_RING_SIZE) {
+			if (trace->drop) {
+				trace->dropped++;
+				return;
+			}
+			trace_wait(trace);
+		}
+	}
+	trace->ring[tail & (TRACE_RING_SIZE - 1)] = *record;
+	atomic_store_explicit(&trace->tail, tail + 1, memory_order_release);
+}
+
+#endif
@@ -2,9 +2,96 @@
 #include <stdlib.h>
 #include "utils.h"
 
-void *read_bytes(FILE *file, uint32_t offset, size_t size) {
-	void *buffer = calloc(1, size);
-	fseek(file, offset, SEEK_SET);
-	fread(buffer, size, 1, file);
-	return buffer;
-}
\ No newline at end of file
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+ * images are mapped shared and read only, so every instance running the same rom uses the
+ * same page cache pages and bank pointers point straight into the mapping
+ */
+#ifdef _WIN32
+
+bool map_file(gb_mapping_t *mapping, const char *path, size_t alignment) {
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return 0;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || !size.QuadPart) {
+		CloseHandle(file);
+		return 0;
+	}
+	mapping->file_size = size.QuadPart;
+	mapping->size = (mapping->file_size + alignment - 1) / alignment * alignment;
+	mapping->copied = mapping->size != mapping->file_size;
+
+	// views can't extend past the end of the file, odd sized images get a padded copy instead
+	if (mapping->copied) {
+		uint8_t *data = VirtualAlloc(NULL, mapping->size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+		DWORD read = 0;
+		if (data && !ReadFile(file, data, (DWORD)mapping->file_size, &read, NULL)) {
+			VirtualFree(data, 0, MEM_RELEASE);
+			data = NULL;
+		}
+		CloseHandle(file);
+		mapping->data = data;
+		return data != NULL;
+	}
+
+	HANDLE view = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!view)
+		return 0;
+	mapping->data = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(view);
+	return mapping->data != NULL;
+}
+
+void unmap_file(gb_mapping_t *mapping) {
+	if (mapping->copied)
+		VirtualFree((void *)mapping->data, 0, MEM_RELEASE);
+	else
+		UnmapViewOfFile(mapping->data);
+	mapping->data = NULL;
+}
+
+#else
+
+bool map_file(gb_mapping_t *mapping, const char *path, size_t alignment) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	struct stat info;
+	if (fstat(fd, &info) || !info.st_size) {
+		close(fd);
+		return 0;
+	}
+	mapping->file_size = info.st_size;
+	mapping->size = (mapping->file_size + alignment - 1) / alignment * alignment;
+
+	// reserve the padded size first so the tail past the end of the file reads as zeros
+	uint8_t *data = mmap(NULL, mapping->size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (data != MAP_FAILED && mmap(data, mapping->file_size, PROT_READ, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(data, mapping->size);
+		data = MAP_FAILED;
+	}
+	close(fd);
+	if (data == MAP_FAILED)
+		return 0;
+	mapping->data = data;
+	return 1;
+}
+
+void unmap_file(gb_mapping_t *mapping) {
+	munmap((void *)mapping->data, mapping->size);
+	mapping->data = NULL;
+}
+
+#endif
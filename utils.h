@@ -3,9 +3,22 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 #define err(x) fprintf(stderr, x)
 
-void *read_bytes(FILE *file, uint32_t offset, size_t size);
+/* a read only view of a whole file, size is rounded up to the requested alignment */
+typedef struct {
+	const uint8_t *data;
+	size_t size;
+	size_t file_size;
+#ifdef _WIN32
+	bool copied;
+#endif
+} gb_mapping_t;
 
-#endif
\ No newline at end of file
+bool map_file(gb_mapping_t *mapping, const char *path, size_t alignment);
+void unmap_file(gb_mapping_t *mapping);
+
+#endif